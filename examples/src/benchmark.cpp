@@ -0,0 +1,52 @@
+#include <flectron.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace flectron;
+
+// Batches quads on the recording backend, so no window or GL context is needed
+static float batchQuads(RecordingRendererBackend& recording, size_t quadCount, uint32_t textureCount)
+{
+  recording.reset();
+  Renderer::beginBatch();
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < quadCount; i++)
+    Renderer::square({ 0.0f, 0.0f }, 1.0f, 100u + (uint32_t)(i % textureCount), 1.0f);
+  Renderer::endBatch();
+  const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  return elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+  Log::init();
+
+  const size_t quadCount = 50000;
+  const uint32_t textureCount = 32;
+  const size_t runs = argc > 1 ? (size_t)std::max(1, std::atoi(argv[1])) : 20;
+
+  // One slot is taken by the white texture
+  Renderer::init(createScope<RecordingRendererBackend>(textureCount + 1));
+  auto& recording = static_cast<RecordingRendererBackend&>(Renderer::backend());
+
+  batchQuads(recording, quadCount, textureCount);
+
+  RollingStatistic timings(runs);
+  for (size_t i = 0; i < runs; i++)
+    timings.add(batchQuads(recording, quadCount, textureCount));
+
+  std::cout << "Batched " << quadCount << " quads over " << textureCount << " textures in " << recording.drawCalls.size() << " draw calls\n";
+  std::cout << "Runs: " << timings.size() << "\n";
+  std::cout << "Average: " << timings.average() << " ms\n";
+  std::cout << "Minimum: " << timings.minimum() << " ms\n";
+  std::cout << "Maximum: " << timings.maximum() << " ms\n";
+  std::cout << "95th percentile: " << timings.percentile(0.95f) << " ms\n";
+
+  Renderer::shutdown();
+  return 0;
+}
@@ -151,6 +151,9 @@ public:
       text << std::floor(stats.circlePercentage() * 100.0f) << "%|";
       text << std::floor(stats.linePercentage() * 100.0f) << "% (";
       text << stats.totalDrawCalls() << ")";
+      text << "\nFlushes: " << stats.flushesPerFrame().latest();
+      text << " (" << (int)(stats.bytesPerFrame().latest() / 1024.0f) << "KiB)";
+      text << " CPU: " << stats.cpuTimes().average() << "ms avg, " << stats.cpuTimes().percentile(0.99f) << "ms p99";
       text << "\nSpawned entities: " << scene.getEntityCount<TemporaryComponent>();
       text << " (" << scene.getEntityCount("Circle") << "|" << scene.getEntityCount("Box") << ")";
       text << "\n" << scene.dateTime->getDay() << "d " << std::floor(scene.dateTime->getTime() * 24.0f);
@@ -188,14 +191,10 @@ public:
       {
         // TODO file might not exist
         sceneFile.load();
-        {
-          auto view = scene.registry.view<TagComponent>();
-          for (auto entity : view)
-            if (view.get<TagComponent>(entity).tag == "Circle" || view.get<TagComponent>(entity).tag == "Box")
-              scene.registry.destroy(entity);
-        }
+        scene.removeEntitiesWithTag("Circle");
+        scene.removeEntitiesWithTag("Box");
         scene.deserialize(sceneFile, [&](Entity entity) {
-          const auto& tag = entity.get<TagComponent>().tag;
+          const auto& tag = entity.get<TagComponent>().tag();
           if (tag == "Player")
           {
             player.destroy();
@@ -220,9 +219,10 @@ public:
           }
           else if (tag == "Triangle")
           {
-            auto view = scene.registry.view<TagComponent>();
-            for (auto other : view)
-              if (view.get<TagComponent>(other).tag == "Triangle" && entity != other)
+            const auto& triangles = scene.getEntitiesWithTag("Triangle");
+            std::vector<entt::entity> others(triangles.begin(), triangles.end());
+            for (auto other : others)
+              if (entity != other)
                 scene.registry.destroy(other);
           }
           else if (tag == "Box")
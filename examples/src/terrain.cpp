@@ -15,6 +15,7 @@ private:
   Ref<WFC::TileInfo> tileInfo;
   Ref<WFC::TileModel> generator;
   Ref<WFC::Output> output;
+  Ref<Tilemap> tilemap;
   Stopwatch timer;
 
 public:
@@ -24,7 +25,8 @@ public:
     pipesText(Text::fromEmbed(PIPES_TXT())),
     tileInfo(nullptr),
     generator(nullptr),
-    output(nullptr)
+    output(nullptr),
+    tilemap(nullptr)
   {
   }
 
@@ -44,23 +46,23 @@ public:
     generator->run(output, 0u, 0u);
     timer.stop();
     FLECTRON_LOG_INFO("Elapsed time: {}", timer.getElapsedTime());
-  }
-
-  void update() override
-  {
-    const auto& tiles = generator->getTiles(output);
 
     const float tileSize = 20.0f;
     const float xOffset = -((float)generator->width*0.5f);
     const float yOffset = -((float)generator->height*0.5f);
 
-    for (size_t y = 0; y < generator->height; ++y)
-      for (size_t x = 0; x < generator->width; ++x)
-        tiles[x][y]->render({(x + xOffset) * tileSize, (y + yOffset) * tileSize}, tileSize);
+    tilemap = createRef<Tilemap>(generator->width, generator->height, tileSize, Vector(xOffset * tileSize, yOffset * tileSize));
+    generator->fillTilemap(output, *tilemap);
+  }
+
+  void update() override
+  {
+    tilemap->render(application.window.camera.getBounds());
   }
 
   void cleanup() override
   {
+    tilemap.reset();
     pipesImage.unloadGPU();
     pipesText.unload();
   }
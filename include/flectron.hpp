@@ -12,8 +12,10 @@
 #include <flectron/utils/memory.hpp>
 #include <flectron/utils/profile.hpp>
 #include <flectron/utils/random.hpp>
+#include <flectron/utils/rolling.hpp>
 #include <flectron/utils/stopwatch.hpp>
 #include <flectron/utils/vertex.hpp>
+#include <flectron/utils/workers.hpp>
 
 // Assets
 #include <flectron/assets/asset.hpp>
@@ -30,11 +32,14 @@
 
 // Renderer
 #include <flectron/renderer/color.hpp>
+#include <flectron/renderer/program_cache.hpp>
 #include <flectron/renderer/shader.hpp>
 #include <flectron/renderer/texture.hpp>
 #include <flectron/renderer/animation.hpp>
 #include <flectron/renderer/renderer.hpp>
+#include <flectron/renderer/backend.hpp>
 #include <flectron/renderer/light.hpp>
+#include <flectron/renderer/tilemap.hpp>
 
 // Scene
 #include <flectron/scene/components.hpp>
@@ -42,6 +47,8 @@
 #include <flectron/scene/entity.hpp>
 #include <flectron/scene/datetime.hpp>
 #include <flectron/scene/grid.hpp>
+#include <flectron/scene/tag.hpp>
+#include <flectron/scene/pool.hpp>
 
 // Generation
 #include <flectron/generation/wfc.hpp>
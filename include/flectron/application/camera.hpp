@@ -52,6 +52,8 @@ namespace flectron
     const glm::mat4& getViewProjectionMatrix() const;
 
     Constraints getConstraints() const;
+    // Axis-aligned area seen by the camera, rotation included
+    Constraints getBounds() const;
     float getScale() const;
 
     void handleWASD();
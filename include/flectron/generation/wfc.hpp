@@ -1,5 +1,6 @@
 #pragma once
 #include <flectron/renderer/renderer.hpp>
+#include <flectron/renderer/tilemap.hpp>
 #include <functional>
 
 namespace flectron { namespace WFC {
@@ -28,16 +29,7 @@ namespace flectron { namespace WFC {
     friend class TileModel;
   };
 
-  struct Tile {
-    GLuint texture;
-    glm::vec4 textureCoords;
-    glm::vec4 ab;
-    glm::vec4 cd;
-
-    Tile(GLuint texture, const glm::vec4& textureCoords, const glm::vec4& ab, const glm::vec4& cd);
-
-    void render(const Vector& position, float size, const Color& color = Colors::white()) const;
-  };
+  using Tile = flectron::Tile;
 
   struct Output {
     bool*** wave;
@@ -68,6 +60,9 @@ namespace flectron { namespace WFC {
     Result findLowestEntropy(const Output* output, RandomDouble& random_double, int& argminx, int& argminy) const;
 
     std::vector<std::vector<Tile*>> getTiles(Ref<Output>& output);
+    // Only the cells that changed since the last fill mark their chunks for rebuilding
+    void fillTilemap(const Ref<Output>& output, Tilemap& tilemap);
+    int getPattern(const Output* output, size_t x, size_t y) const;
     GLuint getTexture() const { return image->getGPU(); }
 
   public:
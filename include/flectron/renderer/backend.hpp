@@ -0,0 +1,332 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <flectron/renderer/shader.hpp>
+#include <flectron/assets/text.hpp>
+
+#ifndef FLECTRON_STREAMING_BUFFERS
+#define FLECTRON_STREAMING_BUFFERS 0
+#endif
+
+#ifndef FLECTRON_STREAMING_REGIONS
+#define FLECTRON_STREAMING_REGIONS 3
+#endif
+
+namespace flectron
+{
+
+  struct TextureVertex
+  {
+    glm::vec2 position;
+    glm::vec4 color;
+    glm::vec2 textureCoord;
+    float textureIndex;
+    float tilingFactor;
+  };
+
+  struct CircleVertex
+  {
+    glm::vec2 worldPosition;
+    glm::vec2 localPosition;
+    glm::vec4 color;
+    float thickness;
+    float fade;
+  };
+
+  // Lines are expanded by the Renderer and drawn as a single triangle strip per batch,
+  // separate polylines are joined by degenerate triangles
+  struct LineVertex
+  {
+    glm::vec2 position;
+    glm::vec4 color;
+  };
+
+  // One record per shape, the instanced vertex shaders expand it into the two triangles of the quad
+  struct QuadInstance
+  {
+    glm::vec2 corners[4];
+    glm::vec4 texturePosition;
+    glm::vec4 color;
+    float textureIndex;
+    float tilingFactor;
+  };
+
+  struct CircleInstance
+  {
+    glm::vec2 corners[4];
+    glm::vec4 color;
+    float thickness;
+    float fade;
+  };
+
+  // Part of a texture batch drawn either from its indices or from its quad instances,
+  // first and count are indices or instances depending on which one it is drawn from
+  struct TextureSegment
+  {
+    bool isInstanced;
+    uint32_t first;
+    uint32_t count;
+  };
+
+  // Batches in the order they were submitted, kept by the recording backend and by static batches
+  struct RecordedBatches
+  {
+    enum class BatchType
+    {
+      Texture, Circle, Line, QuadInstances, CircleInstances, Static
+    };
+
+    // Instanced draws store the instance range in the vertex fields, static draws store the batch in vertexOffset
+    struct DrawCall
+    {
+      BatchType type;
+      size_t vertexOffset;
+      size_t vertexCount;
+      size_t indexOffset;
+      size_t indexCount;
+      std::vector<uint32_t> textureSlots;
+    };
+
+    std::vector<TextureVertex> textureVertices;
+    std::vector<uint32_t> textureIndices;
+    std::vector<CircleVertex> circleVertices;
+    std::vector<LineVertex> lineVertices;
+    std::vector<QuadInstance> quadInstances;
+    std::vector<CircleInstance> circleInstances;
+    std::vector<DrawCall> drawCalls;
+  };
+
+  // Receives the batches built by the Renderer and submits them
+  class RendererBackend
+  {
+  public:
+    static const std::size_t MaxTriangleCount = 10000;
+    static const std::size_t MaxVertexCount = MaxTriangleCount * 3;
+    static const std::size_t MaxIndexCount = MaxTriangleCount * 3;
+    static const std::size_t MaxInstanceCount = MaxVertexCount / 4;
+
+    virtual ~RendererBackend() = default;
+
+    virtual size_t getMaxTextureSlots() const = 0;
+    virtual uint32_t getWhiteTexture() const = 0;
+
+    virtual void setViewProjectionMatrix(const glm::mat4& viewProjection) = 0;
+    virtual void onscreen() = 0;
+    virtual void offscreen() = 0;
+
+    // Negative texture indices sample this array at layer -index - 1, 0 unbinds it
+    virtual void setTextureArray(uint32_t /*textureArray*/) {}
+
+    // A backend can hand out GPU-visible memory for the next batch to be written into,
+    // when it returns nullptr the renderer builds the batch in its own staging arrays
+    virtual TextureVertex* mapTextureVertices() { return nullptr; }
+    virtual uint32_t* mapTextureIndices() { return nullptr; }
+    virtual CircleVertex* mapCircleVertices() { return nullptr; }
+    virtual LineVertex* mapLineVertices() { return nullptr; }
+
+    virtual void drawTextures(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const uint32_t* textureSlots, size_t textureSlotCount) = 0;
+    virtual void drawCircles(const CircleVertex* vertices, size_t vertexCount) = 0;
+    virtual void drawLines(const LineVertex* vertices, size_t vertexCount) = 0;
+
+    // Only called when the backend reports that it supports instancing
+    virtual bool supportsInstancing() const { return false; }
+    virtual void drawQuadInstances(const QuadInstance* /*instances*/, size_t /*instanceCount*/, const uint32_t* /*textureSlots*/, size_t /*textureSlotCount*/) {}
+    virtual void drawCircleInstances(const CircleInstance* /*instances*/, size_t /*instanceCount*/) {}
+    // A texture batch that mixes indexed shapes and quad instances, drawn segment by segment in submission order
+    virtual void drawTextureSegments(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const QuadInstance* instances, size_t instanceCount, const TextureSegment* segments, size_t segmentCount, const uint32_t* textureSlots, size_t textureSlotCount);
+
+    // Static batches keep captured geometry on the backend, so drawing them again uploads nothing
+    virtual uint32_t createStaticBatch(const RecordedBatches& batches) = 0;
+    virtual void drawStaticBatch(uint32_t batch) = 0;
+    virtual void destroyStaticBatch(uint32_t batch) = 0;
+
+    // Times whole frames on the GPU, returns false until a result is available
+    virtual void beginFrameTimer() {}
+    virtual void endFrameTimer() {}
+    virtual bool getFrameTime(float& /*milliseconds*/) { return false; }
+  };
+
+  class OpenGLRendererBackend : public RendererBackend
+  {
+  private:
+    // Persistently mapped buffer split into regions, a region is written again only after
+    // the fence placed behind its last draw has been signaled
+    struct StreamingBuffer
+    {
+      uint8_t* data = nullptr;
+      size_t regionSize = 0;
+      size_t region = 0;
+      GLsync fences[FLECTRON_STREAMING_REGIONS] = {};
+
+      void create(GLenum target, size_t regionSize);
+      void destroy();
+      void* map();
+      void fence();
+      size_t offset() const;
+    };
+
+    struct StaticBatch
+    {
+      GLuint textureVertexArray = 0;
+      GLuint textureVertexBuffer = 0;
+      GLuint textureIndexBuffer = 0;
+      GLuint circleVertexArray = 0;
+      GLuint circleVertexBuffer = 0;
+      GLuint lineVertexArray = 0;
+      GLuint lineVertexBuffer = 0;
+      std::vector<RecordedBatches::DrawCall> drawCalls;
+    };
+
+    std::unordered_map<uint32_t, StaticBatch> staticBatches;
+    uint32_t nextStaticBatch;
+
+    bool streaming;
+    StreamingBuffer textureVertexStream;
+    StreamingBuffer textureIndexStream;
+    StreamingBuffer circleVertexStream;
+    StreamingBuffer lineVertexStream;
+
+    GLuint frameBuffer;
+    GLuint cameraUniformBuffer;
+    size_t maxTextureSlots;
+
+    // Texture rendering
+    GLuint textureVertexArray;
+    GLuint textureVertexBuffer;
+    GLuint textureIndexBuffer;
+    GLuint whiteTexture;
+    GLuint textureArray;
+    GLuint textureArrayUnit;
+
+    Text textureShaderVertex;
+    Text textureShaderFragment;
+    Shader::Pointer textureShader;
+
+    // Circle rendering
+    GLuint circleVertexArray;
+    GLuint circleVertexBuffer;
+    GLuint circleIndexBuffer;
+
+    Text circleShaderVertex;
+    Text circleShaderFragment;
+    Shader::Pointer circleShader;
+
+    // Line rendering
+    GLuint lineVertexArray;
+    GLuint lineVertexBuffer;
+
+    Text lineShaderVertex;
+    Text lineShaderFragment;
+    Shader::Pointer lineShader;
+
+    // Instanced rendering
+    GLuint quadInstanceVertexArray;
+    GLuint quadInstanceBuffer;
+    Text textureInstancedShaderVertex;
+    Shader::Pointer textureInstancedShader;
+
+    GLuint circleInstanceVertexArray;
+    GLuint circleInstanceBuffer;
+    Text circleInstancedShaderVertex;
+    Shader::Pointer circleInstancedShader;
+
+    // Frame timer queries, read back only once their results are available
+    static const size_t FrameTimerCount = 4;
+    GLuint frameTimers[FrameTimerCount];
+    bool isFrameTimerPending[FrameTimerCount];
+    size_t frameTimer;
+    size_t oldestFrameTimer;
+
+  public:
+    OpenGLRendererBackend(int width, int height, GLuint& buffer, bool streaming = FLECTRON_STREAMING_BUFFERS);
+    ~OpenGLRendererBackend();
+
+    size_t getMaxTextureSlots() const override;
+    uint32_t getWhiteTexture() const override;
+
+    void setViewProjectionMatrix(const glm::mat4& viewProjection) override;
+    void onscreen() override;
+    void offscreen() override;
+    void setTextureArray(uint32_t textureArray) override;
+
+    TextureVertex* mapTextureVertices() override;
+    uint32_t* mapTextureIndices() override;
+    CircleVertex* mapCircleVertices() override;
+    LineVertex* mapLineVertices() override;
+
+    void drawTextures(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const uint32_t* textureSlots, size_t textureSlotCount) override;
+    void drawCircles(const CircleVertex* vertices, size_t vertexCount) override;
+    void drawLines(const LineVertex* vertices, size_t vertexCount) override;
+
+    bool supportsInstancing() const override;
+    void drawQuadInstances(const QuadInstance* instances, size_t instanceCount, const uint32_t* textureSlots, size_t textureSlotCount) override;
+    void drawCircleInstances(const CircleInstance* instances, size_t instanceCount) override;
+    void drawTextureSegments(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const QuadInstance* instances, size_t instanceCount, const TextureSegment* segments, size_t segmentCount, const uint32_t* textureSlots, size_t textureSlotCount) override;
+
+    uint32_t createStaticBatch(const RecordedBatches& batches) override;
+    void drawStaticBatch(uint32_t batch) override;
+    void destroyStaticBatch(uint32_t batch) override;
+
+    void beginFrameTimer() override;
+    void endFrameTimer() override;
+    bool getFrameTime(float& milliseconds) override;
+
+  private:
+    static void setTextureAttributes(GLuint vertexArray);
+    static void setCircleAttributes(GLuint vertexArray);
+    static void setLineAttributes(GLuint vertexArray);
+
+    void initTextureRendering();
+    void initCircleRendering();
+    void initLineRendering();
+    void initInstancedRendering();
+    void initCamera();
+  };
+
+  // Keeps everything the Renderer submits in memory instead of drawing it,
+  // so batching can be tested and measured on machines without a GL context
+  class RecordingRendererBackend : public RendererBackend, public RecordedBatches
+  {
+  public:
+    glm::mat4 viewProjection;
+    bool isOffscreen;
+    uint32_t textureArray;
+    std::unordered_map<uint32_t, RecordedBatches> staticBatches;
+
+  private:
+    size_t maxTextureSlots;
+    uint32_t whiteTexture;
+    uint32_t nextStaticBatch;
+
+  public:
+    RecordingRendererBackend(size_t maxTextureSlots = 16, uint32_t whiteTexture = 1u);
+
+    void reset();
+
+    size_t getMaxTextureSlots() const override;
+    uint32_t getWhiteTexture() const override;
+
+    void setViewProjectionMatrix(const glm::mat4& viewProjection) override;
+    void onscreen() override;
+    void offscreen() override;
+    void setTextureArray(uint32_t textureArray) override;
+
+    void drawTextures(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const uint32_t* textureSlots, size_t textureSlotCount) override;
+    void drawCircles(const CircleVertex* vertices, size_t vertexCount) override;
+    void drawLines(const LineVertex* vertices, size_t vertexCount) override;
+
+    bool supportsInstancing() const override;
+    void drawQuadInstances(const QuadInstance* instances, size_t instanceCount, const uint32_t* textureSlots, size_t textureSlotCount) override;
+    void drawCircleInstances(const CircleInstance* instances, size_t instanceCount) override;
+    void drawTextureSegments(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const QuadInstance* instances, size_t instanceCount, const TextureSegment* segments, size_t segmentCount, const uint32_t* textureSlots, size_t textureSlotCount) override;
+
+    uint32_t createStaticBatch(const RecordedBatches& batches) override;
+    void drawStaticBatch(uint32_t batch) override;
+    void destroyStaticBatch(uint32_t batch) override;
+  };
+
+}
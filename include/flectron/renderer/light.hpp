@@ -1,46 +1,162 @@
 #pragma once
 
+#include <vector>
 #include <flectron/renderer/renderer.hpp>
 #include <flectron/utils/memory.hpp>
 #include <flectron/physics/vector.hpp>
 #include <flectron/renderer/color.hpp>
 #include <flectron/scene/components.hpp>
 
+// Lights the buffers start with, they double whenever a frame adds more
 #ifndef FLECTRON_NUM_LIGHTS
 #define FLECTRON_NUM_LIGHTS 512
 #endif
 
+#ifndef FLECTRON_SHADOW_RESOLUTION
+#define FLECTRON_SHADOW_RESOLUTION 256
+#endif
+
 namespace flectron
 {
 
+  // Two texels of the light buffer, shadow is 1 when the light samples its row of the shadow maps
+  struct Light
+  {
+    glm::vec2 position;
+    float radius;
+    float shadow;
+    glm::vec4 color;
+  };
+
+  // 1D polar shadow map, every element is the distance to the closest occluder in its direction
+  // relative to the light radius, the first element points along -x and they go counterclockwise
+  class ShadowMap
+  {
+  public:
+    static const int Resolution = FLECTRON_SHADOW_RESOLUTION;
+
+    static void clear(std::vector<float>& shadowMap);
+    // Casts the shadow of the closed polygon
+    static void cast(std::vector<float>& shadowMap, const Vector& light, float radius, const Vector* vertices, size_t vertexCount);
+  };
+
+  // Splits the view into a grid of tiles, every tile lists only the lights that reach into it
+  class LightTiles
+  {
+  public:
+    static const int Columns = 16;
+    static const int Rows = 16;
+
+  private:
+    // Offset and count of every tile, followed by the light indices they point to
+    std::vector<int> data;
+
+  public:
+    LightTiles();
+
+    void build(const Light* lights, int lightCount, const glm::vec2& min, const glm::vec2& size);
+
+    int getCount(int column, int row) const;
+    const int* getLights(int column, int row) const;
+    const std::vector<int>& getData() const;
+  };
+
   class LightRenderer
   {
+  public:
+    // Tiled shades every pixel with the lights of its tile in one full screen pass, LightMap draws every
+    // light as a quad blended into a scaled down light map, so the cost follows the area lights cover
+    enum class Mode
+    {
+      Tiled, LightMap
+    };
+
   private:
+    // Locations of the uniforms set every frame, resolved once after the shaders are created
+    struct FrameUniforms
+    {
+      int cameraPosition;
+      int windowSize;
+      int baseColor;
+      int darkness;
+    };
+
+    Mode mode;
+
     Text vertexSource;
     Text fragmentSource;
     Shader::Pointer shader;
+    FrameUniforms tiledUniforms;
 
-    float lightsData[FLECTRON_NUM_LIGHTS * 3];
-    float lightsColors[FLECTRON_NUM_LIGHTS * 4];
-
+    std::vector<Light> lights;
     int currentLight;
-    int currentData;
-    int currentColor;
+    // Limited by the height of the shadow texture and the size of the light buffer texture
+    int maxLights;
+    int droppedLights;
+
+    // Copy of what the light buffer holds, only the range that differs from it is uploaded
+    std::vector<Light> uploadedLights;
+
+    // One row per light, rows are uploaded when they change
+    std::vector<float> shadowMaps;
+    int firstDirtyShadow;
+    int lastDirtyShadow;
+    GLuint shadowTexture;
+
+    LightTiles tiles;
 
     GLuint vao;
     GLuint vbo;
     GLuint ibo;
 
+    // Texture buffers read by the shader
+    GLuint lightBuffer;
+    GLuint lightTexture;
+    GLuint tileBuffer;
+    GLuint tileTexture;
+
+    // Light map rendering
+    Text spriteVertexSource;
+    Text spriteFragmentSource;
+    Text compositeFragmentSource;
+    Shader::Pointer spriteShader;
+    Shader::Pointer compositeShader;
+    FrameUniforms lightMapUniforms;
+
+    GLuint spriteVao;
+    GLuint lightMapFrameBuffer;
+    GLuint lightMapColor;
+    GLuint lightMapWeight;
+    int lightMapWidth;
+    int lightMapHeight;
+    float lightMapScale;
+
   public:
-    LightRenderer();
+    LightRenderer(Mode mode = Mode::Tiled, float lightMapScale = 0.5f);
     ~LightRenderer();
 
+    void setMode(Mode mode);
+    Mode getMode() const;
+
+    // Size of the light map relative to the renderer buffer, 0.5 for half and 0.25 for quarter resolution
+    void setLightMapScale(float scale);
+    float getLightMapScale() const;
+
     void reset();
 
     void render(const Color& baseColor, float darkness, const glm::vec3& cameraPosition, const glm::vec2& windowSize, GLuint rendererBuffer);
 
-    void addLight(const Vector& position, float radius, const Color& color);
+    // The shadow map needs ShadowMap::Resolution elements, without one the light is not blocked
+    void addLight(const Vector& position, float radius, const Color& color, const float* shadowMap = nullptr);
+    // Uses the shadow map of the ShadowComponent when the entity has one
     void addLight(Entity entity);
+
+  private:
+    void growLights();
+    void uploadLights();
+    void renderTiled(const Color& baseColor, float darkness, const glm::vec3& cameraPosition, const glm::vec2& windowSize, GLuint rendererBuffer);
+    void renderLightMap(const Color& baseColor, float darkness, const glm::vec3& cameraPosition, const glm::vec2& windowSize, GLuint rendererBuffer);
+    void resizeLightMap(int width, int height);
   };
 
 }
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <initializer_list>
+#include <cstdint>
+
+// Off by default so nothing is written next to the executable, when enabled linked programs are
+// kept in FLECTRON_PROGRAM_CACHE_DIRECTORY, which should point at a writable per-user cache directory
+// (Shader::setProgramCache takes any other cache at runtime)
+#ifndef FLECTRON_PROGRAM_CACHE
+#define FLECTRON_PROGRAM_CACHE 0
+#endif
+
+#ifndef FLECTRON_PROGRAM_CACHE_DIRECTORY
+#define FLECTRON_PROGRAM_CACHE_DIRECTORY "shader_cache"
+#endif
+
+namespace flectron
+{
+
+  // Keeps linked programs in the driver's own binary format, a key covers the shader sources
+  // and the driver that produced the binary, so a driver update simply misses the cache
+  class ProgramCache
+  {
+  public:
+    struct Binary
+    {
+      GLenum format = 0;
+      std::vector<char> data;
+    };
+
+    static uint64_t hash(std::string_view data, uint64_t seed = 14695981039346656037ull);
+    static uint64_t key(const std::string& driver, std::initializer_list<std::string_view> sources);
+
+    virtual ~ProgramCache() = default;
+
+    virtual bool load(uint64_t key, Binary& binary) = 0;
+    virtual void store(uint64_t key, const Binary& binary) = 0;
+  };
+
+  // One file per program, named after its key
+  class FileProgramCache : public ProgramCache
+  {
+  private:
+    std::string directory;
+
+    std::string getPath(uint64_t key) const;
+
+  public:
+    FileProgramCache(const std::string& directory);
+
+    bool load(uint64_t key, Binary& binary) override;
+    void store(uint64_t key, const Binary& binary) override;
+  };
+
+}
@@ -6,12 +6,28 @@
 #include <glm/glm.hpp>
 
 #include <vector>
+#include <array>
+#include <chrono>
 #include <flectron/utils/memory.hpp>
+#include <flectron/utils/rolling.hpp>
 #include <flectron/renderer/shader.hpp>
 #include <flectron/renderer/texture.hpp>
 #include <flectron/renderer/color.hpp>
+#include <flectron/renderer/backend.hpp>
 #include <flectron/application/camera.hpp>
 
+#ifndef FLECTRON_INSTANCED_RENDERING
+#define FLECTRON_INSTANCED_RENDERING 0
+#endif
+
+#ifndef FLECTRON_SORTED_RENDERING
+#define FLECTRON_SORTED_RENDERING 0
+#endif
+
+#ifndef FLECTRON_GPU_TIMING
+#define FLECTRON_GPU_TIMING 0
+#endif
+
 namespace flectron
 {
 
@@ -21,27 +37,96 @@ namespace flectron
 
   class Renderer
   {
-  private:
-    static void initTextureRendering();
-    static void initCircleRendering();
-    static void initLineRendering();
-    static void initCamera();
-
   public:
     static void init(int width, int height, GLuint& buffer);
+    static void init(Scope<RendererBackend> backend);
     static void shutdown();
+
+    // Frame statistics are reset when a frame begins and added to the rolling history when it ends
+    static void beginFrame();
+    static void endFrame();
+
+    // Frames are timed with GPU queries when the backend supports them, results arrive a few frames late
+    static void setGpuTiming(bool enabled);
+    static bool isGpuTiming();
+
+    // Returns the previous backend so it can be restored
+    static Scope<RendererBackend> setBackend(Scope<RendererBackend> backend);
+    static RendererBackend& backend();
+
+    // Quads and ellipses are emitted as one instance each when the backend supports it
+    static void setInstancing(bool enabled);
+    static bool isInstancing();
+
+    // Submissions are queued and sorted by layer, shader and texture before they are batched,
+    // higher layers are drawn on top of lower ones
+    static void setSorting(bool enabled);
+    static bool isSorting();
+    static void setLayer(uint8_t layer, uint32_t depth = 0);
+
+    // Images added to the array are sampled from it instead of taking texture slots, nullptr turns it off
+    // Must not be called while other threads record command buffers, they read the array as they record
+    static void setTextureArray(const Ref<TextureArray>& textureArray);
     static void setViewProjectionMatrix(const Camera& camera);
 
     static void beginBatch();
     static void endBatch();
 
+    // Shapes drawn on a thread that records into a command buffer are kept in the buffer instead of
+    // being batched, so several threads can record at once. The buffers are then submitted on the
+    // render thread, where they are merged into the sorted queue or drawn in the order they were recorded
+    class CommandBuffer
+    {
+    public:
+      // Defined by the renderer, the recorded shapes are opaque to everyone else
+      struct Data;
+
+    private:
+      Scope<Data> data;
+
+    public:
+      CommandBuffer();
+      CommandBuffer(CommandBuffer&& other) noexcept;
+      CommandBuffer& operator=(CommandBuffer&& other) noexcept;
+      ~CommandBuffer();
+
+      size_t size() const;
+      bool empty() const;
+      void clear();
+
+      friend class Renderer;
+    };
+
+    static void beginRecording(CommandBuffer& buffer);
+    static void endRecording();
+    static bool isRecording();
+    static void submit(CommandBuffer& buffer);
+
+    // Everything drawn between these calls is kept by the backend and can be drawn again
+    // without being batched or uploaded, until the static batch is destroyed
+    static void beginStaticBatch();
+    static uint32_t endStaticBatch();
+    static void drawStaticBatch(uint32_t batch);
+    static void destroyStaticBatch(uint32_t batch);
+
+  public:
+    // Why a batch was submitted before the frame ended
+    enum class FlushReason
+    {
+      BatchFull, TextureSlots, Layer, EndBatch
+    };
+
   private:
     static void beginTextureBatch();
     static void beginCircleBatch();
     static void beginLineBatch();
-    static void endTextureBatch();
-    static void endCircleBatch();
-    static void endLineBatch();
+    static void endTextureBatch(FlushReason reason);
+    static void endCircleBatch(FlushReason reason);
+    static void endLineBatch(FlushReason reason);
+    static void flushQueue();
+    static void replay(const CommandBuffer::Data& queue, bool splitLayers);
+    static void polygon(const Vector* vertices, size_t vertexCount, const size_t* triangles, const Color& color);
+    static void polyline(const Vector* vertices, size_t vertexCount, float thickness, bool isClosed, const Color& color);
 
   public:
     static void onscreen();
@@ -85,6 +170,10 @@ namespace flectron
     static void line(const Vector& a, const Vector& b, const Color& color = Colors::white());
     static void line(const Vector& a, const Vector& b, float thickness, const Color& color = Colors::white());
 
+    // Joined lines share the vertices at their corners, an outline also joins the last vertex to the first one
+    static void polyline(const std::vector<Vector>& vertices, float thickness, const Color& color = Colors::white());
+    static void outline(const std::vector<Vector>& vertices, float thickness, const Color& color = Colors::white());
+
     // Circle
     static void point(const Vector& position, const Color& color = Colors::white());
     static void circle(const Vector& center, float radius, const Color& color = Colors::white());
@@ -113,14 +202,45 @@ namespace flectron
   public:
     class Statistics
     {
+    public:
+      using BatchType = RecordedBatches::BatchType;
+      static const size_t BatchTypeCount = (size_t)BatchType::Static + 1;
+      static const size_t FlushReasonCount = (size_t)FlushReason::EndBatch + 1;
+
     private:
+      // Shapes submitted to the renderer
       size_t textureCalls;
       size_t circleCalls;
       size_t lineCalls;
 
+      // Batches submitted to the backend
+      std::array<size_t, BatchTypeCount> flushCounts;
+      std::array<size_t, FlushReasonCount> reasonCounts;
+      size_t vertexCount;
+      size_t indexCount;
+      size_t instanceCount;
+      size_t byteCount;
+
+      float cpuMilliseconds;
+      float sortMilliseconds;
+      float submitMilliseconds;
+      float gpuMilliseconds;
+      std::chrono::steady_clock::time_point frameStart;
+
+      RollingStatistic cpuHistory;
+      RollingStatistic buildHistory;
+      RollingStatistic submitHistory;
+      RollingStatistic gpuHistory;
+      RollingStatistic flushHistory;
+      RollingStatistic byteHistory;
+
+      void recordFlush(BatchType type, FlushReason reason, size_t vertices, size_t indices, size_t instances, size_t bytes, std::chrono::steady_clock::time_point start);
+      void endFrame();
+
     public:
       Statistics();
 
+      // These count shapes, a whole batch of them is usually drawn by a single flush
       size_t textureDrawCalls() const;
       size_t circleDrawCalls() const;
       size_t lineDrawCalls() const;
@@ -130,7 +250,32 @@ namespace flectron
       float circlePercentage() const;
       float linePercentage() const;
 
+      size_t flushes(BatchType type) const;
+      size_t flushes(FlushReason reason) const;
+      size_t totalFlushes() const;
+      size_t vertices() const;
+      size_t indices() const;
+      size_t instances() const;
+      size_t uploadedBytes() const;
+
+      // Milliseconds spent on the frame, building covers everything but sorting and submitting,
+      // the CPU time is only known once the frame has ended
+      float cpuTime() const;
+      float buildTime() const;
+      float sortTime() const;
+      float submitTime() const;
+      float gpuTime() const;
+
+      // Completed frames, at most FLECTRON_STATISTICS_FRAMES of them
+      const RollingStatistic& cpuTimes() const;
+      const RollingStatistic& buildTimes() const;
+      const RollingStatistic& submitTimes() const;
+      const RollingStatistic& gpuTimes() const;
+      const RollingStatistic& flushesPerFrame() const;
+      const RollingStatistic& bytesPerFrame() const;
+
       void reset();
+      void clearHistory();
 
       friend class Renderer;
     };
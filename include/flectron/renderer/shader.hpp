@@ -6,12 +6,33 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <cstdint>
 #include <unordered_map>
 #include <flectron/assets/text.hpp>
+#include <flectron/utils/memory.hpp>
+#include <flectron/renderer/program_cache.hpp>
 
 namespace flectron 
 {
 
+  constexpr uint32_t hashUniformName(const char* name, size_t length, uint32_t hash = 2166136261u)
+  {
+    return length == 0 ? hash : hashUniformName(name + 1, length - 1, (hash ^ (uint8_t)name[0]) * 16777619u);
+  }
+
+  // Uniform name hashed at compile time, so looking it up builds no string
+  struct UniformName
+  {
+    uint32_t hash;
+    const char* name;
+
+    template<size_t N>
+    constexpr explicit UniformName(const char (&name)[N])
+      : hash(hashUniformName(name, N - 1)), name(name) {}
+
+    UniformName(const std::string& name);
+  };
+
   class Shader
   {
   public:
@@ -47,18 +68,33 @@ namespace flectron
       ~ShadersAttacher();
     };
 
+    struct CachedLocation
+    {
+      int location;
+      std::string name;
+    };
+
   private:
     GLuint rendererID;
-    std::unordered_map<std::string, int> locationCache;
-    std::unordered_map<std::string, GLuint> uniformBlockBindings;
+    std::unordered_map<uint32_t, CachedLocation> locationCache;
+    std::unordered_map<uint32_t, CachedLocation> blockIndexCache;
+    std::unordered_map<uint32_t, GLuint> uniformBlockBindings;
     Shaders shaders;
 
     static GLint maxUniformBlockBinings;
     static GLint getMaxUniformBlockBinings();
 
-    int getUniformLocation(const std::string& name);
-    int getUniformBlockIndex(const std::string& name);
-    GLuint getUniformBlockBinding(const std::string& name);
+    static Scope<ProgramCache> programCache;
+    static std::string driver;
+
+    void build();
+    uint64_t getCacheKey() const;
+    bool loadBinary(uint64_t key);
+    void storeBinary(uint64_t key);
+
+    int getUniformBlockIndex(const UniformName& name);
+    GLuint getUniformBlockBinding(const UniformName& name);
+    static bool findCachedLocation(std::unordered_map<uint32_t, CachedLocation>& cache, const UniformName& name, int& location);
     static GLuint compileShader(GLenum type, const std::string& source);
 
     void linkAndValidate();
@@ -73,6 +109,11 @@ namespace flectron
     static void init();
     static Pointer create(const Shaders& shaders);
 
+    // Linked programs are loaded from the cache instead of being compiled when their sources
+    // and the driver match, returns the previous cache so it can be restored
+    static Scope<ProgramCache> setProgramCache(Scope<ProgramCache> cache);
+    static ProgramCache* getProgramCache();
+
     void addShader(ShaderType type, const TextView& source);
     
     void reload();
@@ -83,6 +124,30 @@ namespace flectron
 
     GLuint getRendererID() const;
 
+    // Locations are resolved once and stay valid until the shader is reloaded
+    int getUniformLocation(const UniformName& name);
+
+    void setUniform1i(int location, int value);
+    void setUniform1f(int location, float value);
+    void setUniform2f(int location, float v1, float v2);
+    void setUniform4f(int location, float v0, float v1, float v2, float v3);
+    void setUniformMat4f(int location, const glm::mat4& matrix);
+    void setUniform1iv(int location, int* array, int size);
+    void setUniform2fv(int location, float* array, int size);
+    void setUniform3fv(int location, float* array, int size);
+    void setUniform4fv(int location, float* array, int size);
+
+    void setUniform1i(const UniformName& name, int value);
+    void setUniform1f(const UniformName& name, float value);
+    void setUniform2f(const UniformName& name, float v1, float v2);
+    void setUniform4f(const UniformName& name, float v0, float v1, float v2, float v3);
+    void setUniformMat4f(const UniformName& name, const glm::mat4& matrix);
+    void setUniform1iv(const UniformName& name, int* array, int size);
+    void setUniform2fv(const UniformName& name, float* array, int size);
+    void setUniform3fv(const UniformName& name, float* array, int size);
+    void setUniform4fv(const UniformName& name, float* array, int size);
+    void setUniformBlock(const UniformName& name, GLuint bindingPoint);
+
     void setUniform1i(const std::string& name, int value);
     void setUniform1f(const std::string& name, float value);
     void setUniform2f(const std::string& name, float v1, float v2);
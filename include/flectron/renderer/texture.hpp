@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <array>
 #include <unordered_map>
 
 #include <flectron/assets/image.hpp>
@@ -15,6 +16,35 @@ namespace flectron
   
   GLuint createFrameBuffer(int width, int height, GLuint& buffer);
 
+  // Same-sized images packed into the layers of a GL_TEXTURE_2D_ARRAY, the renderer
+  // samples them by layer so they do not take up texture slots
+  class TextureArray
+  {
+  private:
+    GLuint textureID;
+    int width;
+    int height;
+    int capacity;
+    std::unordered_map<GLuint, int> layers;
+
+  public:
+    TextureArray(int width, int height, int capacity, const Image::Parameters& parameters = Image::defaultParameters);
+    ~TextureArray();
+
+    TextureArray(const TextureArray&) = delete;
+    TextureArray& operator=(const TextureArray&) = delete;
+
+    TextureArray(TextureArray&&) = delete;
+    TextureArray& operator=(TextureArray&&) = delete;
+
+    // The image has to be loaded and uploaded, its texture is then drawn from the array,
+    // returns -1 when the array is full and the texture keeps being drawn from a slot
+    int add(const Image& image);
+    int getLayer(GLuint texture) const;
+    GLuint getGPU() const;
+    size_t size() const;
+  };
+
   class TextureAtlas
   {
   public:
@@ -43,7 +73,8 @@ namespace flectron
   {
   private:
     std::string alphabet;
-    std::unordered_map<char, int> indexMap;
+    // Texture position of every char, characters missing from the alphabet get its first glyph
+    std::array<glm::vec4, 256> glyphs;
 
   public:
     FontAtlas(const Image& image, int columns, int rows, const std::string& alphabet);
@@ -55,7 +86,8 @@ namespace flectron
     FontAtlas(FontAtlas&&) = delete;
     FontAtlas& operator=(FontAtlas&&) = delete;
 
-    GLuint get(const std::string& text, glm::vec4* texturePositions);
+    GLuint get(const std::string& text, glm::vec4* texturePositions) const;
+    const glm::vec4& getGlyph(char character) const;
     glm::vec2 getOffsets() const;
   };
 
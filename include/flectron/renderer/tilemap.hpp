@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <flectron/renderer/renderer.hpp>
+#include <flectron/application/camera.hpp>
+
+namespace flectron
+{
+
+  // Textured unit square, the corners allow rotated and mirrored variants of the same texture
+  struct Tile
+  {
+    GLuint texture;
+    glm::vec4 textureCoords;
+    glm::vec4 ab;
+    glm::vec4 cd;
+
+    Tile(GLuint texture, const glm::vec4& textureCoords, const glm::vec4& ab, const glm::vec4& cd);
+
+    void render(const Vector& position, float size, const Color& color = Colors::white()) const;
+  };
+
+  // Grid of tiles baked into static batches chunk by chunk, a chunk is rebuilt only
+  // after one of its tiles changes and is drawn only when it is in view
+  class Tilemap
+  {
+  public:
+    static const size_t ChunkSize = 16;
+
+  private:
+    struct Chunk
+    {
+      uint32_t batch = 0;
+      bool isDirty = true;
+    };
+
+    size_t width;
+    size_t height;
+    float tileSize;
+    Vector position;
+    std::vector<const Tile*> tiles;
+
+    size_t columns;
+    size_t rows;
+    std::vector<Chunk> chunks;
+
+  public:
+    Tilemap(size_t width, size_t height, float tileSize, const Vector& position);
+    ~Tilemap();
+
+    Tilemap(const Tilemap&) = delete;
+    Tilemap& operator=(const Tilemap&) = delete;
+
+    Tilemap(Tilemap&&) = delete;
+    Tilemap& operator=(Tilemap&&) = delete;
+
+    void set(size_t x, size_t y, const Tile* tile);
+    const Tile* get(size_t x, size_t y) const;
+
+    size_t getWidth() const;
+    size_t getHeight() const;
+
+    void invalidate();
+    void render();
+    void render(const Constraints& constraints);
+
+  private:
+    void renderChunk(size_t column, size_t row);
+  };
+
+}
@@ -4,13 +4,17 @@
 #include <flectron/renderer/color.hpp>
 #include <flectron/renderer/renderer.hpp>
 #include <flectron/renderer/animation.hpp>
+#include <flectron/renderer/tilemap.hpp>
 #include <flectron/scene/entity.hpp>
+#include <flectron/scene/tag.hpp>
 #include <vector>
 #include <array>
 
 namespace flectron 
 {
 
+  class EntityPool;
+
   enum ShapeType
   {
     Circle, Box, Polygon
@@ -24,9 +28,14 @@ namespace flectron
   struct TagComponent
   {
     Entity entity;
-    std::string tag;
+    TagID id;
+    TagID indexedID; // the ID under which the scene currently indexes this entity
 
     TagComponent(Entity entity, const std::string& tag);
+    TagComponent(Entity entity, TagID id);
+
+    const std::string& tag() const;
+    void setTag(const std::string& tag);
   };
 
   struct UUIDComponent
@@ -146,6 +155,7 @@ namespace flectron
     Entity entity;
     std::pair<std::pair<int,int>, std::pair<int,int>> clientIndices;
     int clientQuery;
+    bool isStale;
 
     SpatialHashGridComponent(Entity entity, const std::pair<std::pair<int,int>, std::pair<int,int>>& clientIndices, int clientQuery);
   };
@@ -217,19 +227,79 @@ namespace flectron
     LightComponent(Entity entity, float lightRadius, const Color& lightColor);
   };
 
+  // Lights with this component are blocked by occluders, the shadow map is only rebuilt
+  // after the light or an occluder within its radius moves
+  struct ShadowComponent
+  {
+    Entity entity;
+    std::vector<float> shadowMap;
+    Vector position;
+    float radius;
+    bool isDirty;
+
+    ShadowComponent(Entity entity);
+  };
+
+  // The edges of the entity's vertices cast shadows from lights with a ShadowComponent
+  struct OccluderComponent
+  {
+    Entity entity;
+    AABB bounds;
+    bool isDirty;
+
+    OccluderComponent(Entity entity);
+  };
+
+  // Tilemaps are drawn below everything else in the scene
+  struct TilemapComponent
+  {
+    Entity entity;
+    Ref<Tilemap> tilemap;
+
+    TilemapComponent(Entity entity, const Ref<Tilemap>& tilemap);
+  };
+
   struct TemporaryComponent
   {
     Entity entity;
     TemporaryComponent(Entity entity);
   };
 
+  // Marks pooled entities that are waiting to be reused, systems skip them
+  struct InactiveComponent
+  {
+    Entity entity;
+    InactiveComponent(Entity entity);
+  };
+
+  // Marks entities that never move, they are rendered from a retained static batch
+  struct StaticComponent
+  {
+    Entity entity;
+    StaticComponent(Entity entity);
+  };
+
+  struct PooledComponent
+  {
+    Entity entity;
+    EntityPool* pool;
+    PooledComponent(Entity entity, EntityPool* pool);
+  };
+
   struct ScriptComponent
   {
     Entity entity;
     std::function<void()> callback;
+
+  private:
+    // Only changed through setOrder, which marks the scripts for resorting
     int order;
 
+  public:
     ScriptComponent(Entity entity, std::function<void()> callback, int order = 0);
+
+    int getOrder() const;
+    void setOrder(int order);
   };
 
   struct SerializationComponent
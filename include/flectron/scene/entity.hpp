@@ -54,6 +54,7 @@ namespace flectron {
     }
 
     void destroy();
+    entt::entity getHandle() const;
 
     template<typename Component>
     void patch()
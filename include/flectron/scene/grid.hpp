@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <unordered_set>
 #include <unordered_map>
 #include <entt/entt.hpp>
@@ -19,6 +20,7 @@ namespace flectron
     std::unordered_map<ULL, std::unordered_set<entt::entity>> cells;
     int cellSize;
     int queryIdentifier;
+    std::vector<entt::entity> staleEntities;
     entt::registry& registry; // TODO try to seperate this from the scene
 
   public:
@@ -27,11 +29,18 @@ namespace flectron
     void insert(entt::entity entity);
     void remove(entt::entity entity);
     void clear();
+
+    // Entities moved outside of physics are re-inserted in bulk before the grid is queried
+    void markStale(entt::entity entity);
+    void update();
     
     std::vector<entt::entity> getCells(const AABB& aabb);
+    std::vector<entt::entity> getEntitiesOutside(const AABB& aabb);
 
   private:
-    inline ULL getHash(int a, int b) { return (ULL)a << 32 | (UL)b; };
+    inline ULL getHash(int a, int b) { return (ULL)(uint32_t)a << 32 | (ULL)(uint32_t)b; };
+    inline int getX(ULL hash) { return (int)(uint32_t)(hash >> 32); };
+    inline int getY(ULL hash) { return (int)(uint32_t)hash; };
   };
 
 }
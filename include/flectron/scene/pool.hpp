@@ -0,0 +1,35 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <entt/entt.hpp>
+#include <flectron/physics/vector.hpp>
+#include <flectron/scene/entity.hpp>
+
+namespace flectron
+{
+
+  class Scene;
+
+  // Keeps released entities around fully formed, so that spawning reuses their components
+  // instead of constructing them (and rebuilding their vertices) again
+  class EntityPool
+  {
+  private:
+    Scene& scene;
+    std::string name;
+    std::function<void(Entity)> prefab;
+    std::vector<entt::entity> inactive;
+
+  public:
+    EntityPool(Scene& scene, const std::string& name, std::function<void(Entity)> prefab);
+
+    Entity acquire(const Vector& position, float rotation = 0.0f);
+    void release(Entity entity);
+    void reserve(size_t count);
+    void clear();
+
+    size_t available() const;
+  };
+
+}
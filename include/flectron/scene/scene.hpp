@@ -1,16 +1,23 @@
 #pragma once
 #include <entt/entt.hpp>
+#include <unordered_set>
 #include <flectron/scene/datetime.hpp>
 #include <flectron/scene/components.hpp>
 #include <flectron/scene/grid.hpp>
+#include <flectron/scene/pool.hpp>
 #include <flectron/application/window.hpp>
 #include <flectron/renderer/light.hpp>
 #include <flectron/scene/entity.hpp>
 #include <flectron/assets/scene.hpp>
+#include <flectron/utils/workers.hpp>
 
 #define FLECTRON_PHYSICS 100
 #define FLECTRON_RENDER 200
 
+#ifndef FLECTRON_RENDER_THREADS
+#define FLECTRON_RENDER_THREADS 1
+#endif
+
 namespace flectron
 {
 
@@ -67,6 +74,18 @@ namespace flectron
     Scope<DateTime> dateTime;
     size_t physicsIterations;
 
+  private:
+    bool isScriptSortRequired;
+    bool isStaticBatchDirty;
+    uint32_t staticBatch;
+    std::vector<entt::entity> movedOccluders;
+    size_t renderThreads;
+    std::vector<Renderer::CommandBuffer> renderBuffers;
+    // Started the first time entities are split between threads and kept for the next frames
+    Scope<WorkerPool> renderWorkers;
+    std::vector<std::unordered_set<entt::entity>> tagIndex;
+    std::vector<Scope<EntityPool>> pools;
+
   public:
     Scene(size_t physicsIterations, size_t gridSize);
     ~Scene();
@@ -77,17 +96,49 @@ namespace flectron
     void update(Application& application);
     void updatePhysics(float elapsedTime, size_t iterations);
     void render(Window& window);
+    // Batches the entities without touching the window, used by headless backends
+    void renderEntities();
+    // Only batches entities overlapping the constraints
+    void renderEntities(const Constraints& constraints);
+    // Moving a static entity rebuilds the static batch, other changes to how it looks have to be reported
+    void invalidateStaticBatch();
+    // Moving lights and occluders rebuilds the shadows they touch, other changes to occluders have to be reported
+    void invalidateShadows();
+    // Visible entities are split between this many threads that record them at once, 1 keeps rendering on the calling thread
+    void setRenderThreads(size_t threads);
+    size_t getRenderThreads() const;
 
     friend class Entity;
     Entity createEntity(const std::string& name, const Vector& position, float rotation);
     Entity createEntity();
     Entity createScript(const std::string& name, std::function<void()> callback, int order = 0);
+    EntityPool& createPool(const std::string& name, std::function<void(Entity)> prefab);
+
+    // Systems are scripts that run the function over every entity with the given components.
+    // The function is called directly by the view, so the per-entity call is not type-erased
+    template<typename ...Components, typename Function>
+    Entity addSystem(const std::string& name, Function function, int order = 0)
+    {
+      return createScript(name, [this, function]() mutable {
+        registry.view<Components...>(entt::exclude<InactiveComponent>).each(std::ref(function));
+      }, order);
+    }
+
+    template<typename ...Components, typename Function>
+    Entity addSystem(Function function, int order = 0)
+    {
+      return addSystem<Components...>("System", function, order);
+    }
 
     auto getScriptComponents()
     {
-      registry.sort<ScriptComponent>([](const ScriptComponent& a, const ScriptComponent& b) {
-        return a.order < b.order;
-      });
+      if (isScriptSortRequired)
+      {
+        registry.sort<ScriptComponent>([](const ScriptComponent& a, const ScriptComponent& b) {
+          return a.getOrder() < b.getOrder();
+        });
+        isScriptSortRequired = false;
+      }
       return registry.view<ScriptComponent>();
     }
     
@@ -96,55 +147,62 @@ namespace flectron
     template<typename ...Components>
     size_t getEntityCount() const
     {
-      return registry.view<Components...>().size();
+      // Only pooled entities carry InactiveComponent, so walking them and subtracting keeps the count cheap
+      auto inactive = registry.view<Components..., InactiveComponent>();
+      const size_t pooled = static_cast<size_t>(std::distance(inactive.begin(), inactive.end()));
+      return registry.view<Components...>().size() - pooled;
     }
 
-    size_t getEntityCount(const std::string& tag) const
-    {
-      size_t count = 0;
-      auto view = registry.view<TagComponent>();
-      for (auto entity : view)
-        if (registry.get<TagComponent>(entity).tag == tag)
-          ++count;
-      return count;
-    }
+    size_t getEntityCount(const std::string& tag) const;
+    const std::unordered_set<entt::entity>& getEntitiesWithTag(const std::string& tag) const;
+    void removeEntitiesWithTag(const std::string& tag);
 
     void onPhysicsComponentCreate(entt::registry&, entt::entity entity);
     void onSpatialHashGridComponentDestroy(entt::registry&, entt::entity entity);
-    static void onPositionComponentUpdate(entt::registry& registry, entt::entity entity);
+    void onScriptComponentChange(entt::registry&, entt::entity);
+    void onTagComponentCreate(entt::registry& registry, entt::entity entity);
+    void onTagComponentUpdate(entt::registry& registry, entt::entity entity);
+    void onTagComponentDestroy(entt::registry& registry, entt::entity entity);
+    void onInactiveComponentCreate(entt::registry& registry, entt::entity entity);
+    void onInactiveComponentDestroy(entt::registry& registry, entt::entity entity);
+    void onStaticComponentChange(entt::registry& registry, entt::entity entity);
+    void onPositionComponentUpdate(entt::registry& registry, entt::entity entity);
+    void onOccluderComponentCreate(entt::registry& registry, entt::entity entity);
+    void onOccluderComponentDestroy(entt::registry& registry, entt::entity entity);
     static void onBodyDefiningComponentCreate(entt::registry& registry, entt::entity entity);
 
     void clear();
 
+    // Pooled entities are released back to their pool instead of being destroyed
     void removeEntity(entt::entity entity);
+    void removeEntities(std::vector<entt::entity>& entities);
 
     template<typename ...Components>
     void removeEntitiesOutside(const Constraints& constraints)
     {
-      auto view = registry.view<Components...>();
-      for (auto entity : view)
-      {
-        auto& pc = registry.get<PositionComponent>(entity);
-        if (registry.all_of<VertexComponent>(entity))
-        {
-          const AABB& box = registry.get<VertexComponent>(entity).getAABB(pc);
-
-          if (box.max.x < constraints.left || box.min.x > constraints.right ||
-              box.max.y < constraints.top  || box.min.y > constraints.bottom)
-          {
-            removeEntity(entity);
-          }
-        }
-        else
-        {
-          if (pc.position.x < constraints.left || pc.position.x > constraints.right ||
-              pc.position.y < constraints.top  || pc.position.y > constraints.bottom)
-          {
-            removeEntity(entity);
-          }
-        }
-      }
+      std::vector<entt::entity> outside;
+      grid.update();
+
+      // Entities tracked by the grid are only tested if they occupy a cell crossing the constraints, this
+      // lowers the constant factor but every occupied cell and every entity outside the grid is still visited
+      for (auto entity : grid.getEntitiesOutside({ constraints.left, constraints.top, constraints.right, constraints.bottom }))
+        if (registry.all_of<Components...>(entity) && isOutside(entity, constraints))
+          outside.push_back(entity);
+
+      for (auto entity : registry.view<Components...>(entt::exclude<SpatialHashGridComponent, InactiveComponent>))
+        if (isOutside(entity, constraints))
+          outside.push_back(entity);
+
+      removeEntities(outside);
     }
+
+  private:
+    bool isOutside(entt::entity entity, const Constraints& constraints);
+    bool isRenderable(entt::entity entity) const;
+    void updateStaticBatch();
+    void renderVisible(const std::vector<entt::entity>& visible);
+    void updateOccluders();
+    void updateShadow(entt::entity entity, ShadowComponent& sc);
   };
 
 }
\ No newline at end of file
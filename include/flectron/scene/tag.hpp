@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace flectron
+{
+
+  using TagID = uint32_t;
+
+  // Interns tag names so that components and indices can work with integer IDs
+  class Tags
+  {
+  private:
+    static std::unordered_map<std::string, TagID> ids;
+    static std::vector<std::string> names;
+
+  public:
+    static constexpr TagID Invalid = std::numeric_limits<TagID>::max();
+
+    static TagID intern(const std::string& tag);
+    // Looks a tag up without interning it, unknown tags are Invalid
+    static TagID find(const std::string& tag);
+    static const std::string& name(TagID id);
+    static size_t count();
+  };
+
+}
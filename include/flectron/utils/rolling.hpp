@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#ifndef FLECTRON_STATISTICS_FRAMES
+#define FLECTRON_STATISTICS_FRAMES 120
+#endif
+
+namespace flectron
+{
+
+  // Summarizes the last few samples, older ones are overwritten
+  class RollingStatistic
+  {
+  private:
+    std::vector<float> samples;
+    size_t next;
+    size_t count;
+
+  public:
+    RollingStatistic(size_t capacity = FLECTRON_STATISTICS_FRAMES);
+
+    void add(float sample);
+    void clear();
+
+    size_t size() const;
+    size_t capacity() const;
+
+    float latest() const;
+    float minimum() const;
+    float maximum() const;
+    float average() const;
+
+    // Nearest-rank percentile, fraction goes from 0 to 1
+    float percentile(float fraction) const;
+  };
+
+}
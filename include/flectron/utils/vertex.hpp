@@ -8,7 +8,9 @@ namespace flectron
 
   enum WindingOrder : short;
 
+  // Counter-clockwise outlines are reversed in place, the result is cached for outlines seen again
   std::vector<size_t> trianglesFromVertices(std::vector<Vector>& vertices);
+  void clearTriangulationCache();
   int getIndex(int index, int length);
   bool isPointInTriangle(const Vector& point, const Vector& a, const Vector& b, const Vector& c);
   WindingOrder getWindingOrder(const std::vector<Vector>& vertices);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <cstddef>
+
+namespace flectron
+{
+
+  // Threads that are started once and kept waiting for jobs, jobs are taken in the order they were submitted
+  class WorkerPool
+  {
+  private:
+    std::vector<std::thread> threads;
+    std::deque<std::packaged_task<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool isStopping;
+
+  public:
+    WorkerPool(size_t threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const;
+
+    // The future rethrows whatever the job threw
+    std::future<void> submit(std::function<void()> job);
+
+  private:
+    void work();
+  };
+
+}
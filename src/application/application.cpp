@@ -53,12 +53,13 @@ namespace flectron
       mouseWorldPosition.x = (mousePosition.x - window.properties.width * 0.5f) * scale + cameraPosition.x;
       mouseWorldPosition.y = (window.properties.height * 0.5f - mousePosition.y) * scale + cameraPosition.y;
 
-      Renderer::statistics().reset();
+      Renderer::beginFrame();
       Renderer::setViewProjectionMatrix(window.camera);
       Renderer::beginBatch();
       for (auto layer : layers)
         layer->update();
       Renderer::endBatch();
+      Renderer::endFrame();
 
       window.swapBuffers();
       window.pollEvents();
@@ -1,5 +1,8 @@
 #include <flectron/application/camera.hpp>
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 #include <flectron/utils/input.hpp>
 #include <flectron/physics/math.hpp>
@@ -100,6 +103,31 @@ namespace flectron
     return constraints + position;
   }
 
+  Constraints Camera::getBounds() const
+  {
+    if (rotation == 0.0f)
+      return getConstraints();
+
+    const float c = cos(rotation);
+    const float s = sin(rotation);
+    const glm::vec2 corners[4] = {
+      { constraints.left, constraints.top }, { constraints.right, constraints.top },
+      { constraints.right, constraints.bottom }, { constraints.left, constraints.bottom }
+    };
+
+    Constraints bounds(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+    for (const auto& corner : corners)
+    {
+      const float x = corner.x * c - corner.y * s + position.x;
+      const float y = corner.x * s + corner.y * c + position.y;
+      bounds.left = std::min(bounds.left, x);
+      bounds.right = std::max(bounds.right, x);
+      bounds.top = std::min(bounds.top, y);
+      bounds.bottom = std::max(bounds.bottom, y);
+    }
+    return bounds;
+  }
+
   float Camera::getScale() const
   {
     return scale;
@@ -1,5 +1,6 @@
 #include <flectron/generation/wfc.hpp>
 #include <flectron/utils/random.hpp>
+#include <flectron/assert/assert.hpp>
 #include <fstream>
 #include <sstream>
 #include <functional>
@@ -74,22 +75,6 @@ namespace flectron { namespace WFC{
     }
   }
 
-  Tile::Tile(GLuint texture, const glm::vec4& textureCoords, const glm::vec4& ab, const glm::vec4& cd) 
-    : texture(texture), textureCoords(textureCoords), ab(ab), cd(cd) 
-  {}
-
-  void Tile::render(const Vector& position, float size, const Color& color) const
-  {
-    Renderer::quad(
-      {position.x + ab.x * size, position.y + ab.y * size},
-      {position.x + ab.z * size, position.y + ab.w * size},
-      {position.x + cd.x * size, position.y + cd.y * size},
-      {position.x + cd.z * size, position.y + cd.w * size},
-      texture,
-      textureCoords,
-      color);
-  }
-
   const auto kInvalidIndex = static_cast<size_t>(-1);
 
   Output::Output(int w, int h, int d)
@@ -503,30 +488,43 @@ namespace flectron { namespace WFC{
     {
       tiles.push_back(std::vector<Tile*>());
       for (size_t j = 0; j < height; ++j)
+        tiles[i].push_back(tileMap[getPattern(output.get(), i, j)]);
+    }
+    return tiles;
+  }
+
+  void TileModel::fillTilemap(const Ref<Output>& output, Tilemap& tilemap)
+  {
+    FLECTRON_ASSERT(tilemap.getWidth() == width && tilemap.getHeight() == height, "Tilemap does not match the size of the model");
+
+    // Resolved once per fill instead of hashing every cell
+    std::vector<const Tile*> patternTiles(numPatterns + 1, nullptr);
+    for (int pattern = -1; pattern < (int)numPatterns; ++pattern)
+    {
+      auto it = tileMap.find(pattern);
+      if (it != tileMap.end())
+        patternTiles[pattern + 1] = it->second;
+    }
+
+    for (size_t j = 0; j < height; ++j)
+      for (size_t i = 0; i < width; ++i)
+        tilemap.set(i, j, patternTiles[getPattern(output.get(), i, j) + 1]);
+  }
+
+  // Returns the only pattern left in the cell or -1 while it is still undecided
+  int TileModel::getPattern(const Output* output, size_t x, size_t y) const
+  {
+    int selected = -1;
+    for (size_t k = 0; k < numPatterns; ++k)
+    {
+      if (output->wave[x][y][k])
       {
-        int selected = -1;
-        for (size_t k = 0; k < numPatterns; ++k)
-        {
-          if (output->wave[i][j][k])
-          {
-            if (selected == -1)
-            {
-              selected = k;
-            }
-            else
-            {
-              selected = -1;
-              break;
-            }
-          }
-        }
-        // std::cout << selected << " ";
-        tiles[i].push_back(tileMap[selected]);
+        if (selected != -1)
+          return -1;
+        selected = (int)k;
       }
-      // std::cout << std::endl;
     }
-    // std::cout << std::endl << std::endl;
-    return tiles;
+    return selected;
   }
 
 } }
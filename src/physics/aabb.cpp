@@ -14,10 +14,7 @@ namespace flectron
 
   void AABB::render(float width, const Color& color) const
   {
-    Renderer::line(min, { max.x, min.y }, width, color);
-    Renderer::line({ max.x, min.y }, max, width, color);
-    Renderer::line(max, { min.x, max.y }, width, color);
-    Renderer::line({ min.x, max.y }, min, width, color);
+    Renderer::outline({ min, { max.x, min.y }, max, { min.x, max.y } }, width, color);
   }
 
 }
@@ -0,0 +1,914 @@
+#include <flectron/renderer/backend.hpp>
+#include <flectron/renderer/texture.hpp>
+#include <flectron/utils/embed.hpp>
+#include <flectron/assert/log.hpp>
+#include <flectron/assert/assert.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+
+FLECTRON_EMBED(FLECTRON_SHADER_TEXTURE_VERT);
+FLECTRON_EMBED(FLECTRON_SHADER_TEXTURE_FRAG);
+FLECTRON_EMBED(FLECTRON_SHADER_CIRCLE_VERT);
+FLECTRON_EMBED(FLECTRON_SHADER_CIRCLE_FRAG);
+FLECTRON_EMBED(FLECTRON_SHADER_LINE_VERT);
+FLECTRON_EMBED(FLECTRON_SHADER_LINE_FRAG);
+FLECTRON_EMBED(FLECTRON_SHADER_TEXTURE_INSTANCED_VERT);
+FLECTRON_EMBED(FLECTRON_SHADER_CIRCLE_INSTANCED_VERT);
+
+namespace flectron
+{
+
+  // Bound before every draw, so it is looked up by its precomputed hash
+  static constexpr UniformName CameraBlock("CameraBlock");
+
+  // Backends that cannot draw ranges of one upload submit every segment as its own batch
+  void RendererBackend::drawTextureSegments(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t /*indexCount*/, const QuadInstance* instances, size_t /*instanceCount*/, const TextureSegment* segments, size_t segmentCount, const uint32_t* textureSlots, size_t textureSlotCount)
+  {
+    for (size_t i = 0; i < segmentCount; i++)
+    {
+      const TextureSegment& segment = segments[i];
+      if (segment.isInstanced)
+        drawQuadInstances(instances + segment.first, segment.count, textureSlots, textureSlotCount);
+      else
+        drawTextures(vertices, vertexCount, indices + segment.first, segment.count, textureSlots, textureSlotCount);
+    }
+  }
+
+  void OpenGLRendererBackend::StreamingBuffer::create(GLenum target, size_t regionSize)
+  {
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    this->regionSize = regionSize;
+    glBufferStorage(target, regionSize * FLECTRON_STREAMING_REGIONS, nullptr, flags);
+    data = (uint8_t*)glMapBufferRange(target, 0, regionSize * FLECTRON_STREAMING_REGIONS, flags);
+  }
+
+  void OpenGLRendererBackend::StreamingBuffer::destroy()
+  {
+    for (auto& fence : fences)
+    {
+      if (fence)
+        glDeleteSync(fence);
+      fence = nullptr;
+    }
+    data = nullptr;
+  }
+
+  void* OpenGLRendererBackend::StreamingBuffer::map()
+  {
+    GLsync& fence = fences[region];
+    if (fence)
+    {
+      while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+    return data + offset();
+  }
+
+  void OpenGLRendererBackend::StreamingBuffer::fence()
+  {
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % FLECTRON_STREAMING_REGIONS;
+  }
+
+  size_t OpenGLRendererBackend::StreamingBuffer::offset() const
+  {
+    return region * regionSize;
+  }
+
+  OpenGLRendererBackend::OpenGLRendererBackend(int width, int height, GLuint& buffer, bool streaming)
+    : staticBatches(), nextStaticBatch(1), streaming(streaming && GLEW_ARB_buffer_storage), frameBuffer(0), cameraUniformBuffer(0), maxTextureSlots(0),
+      textureVertexArray(0), textureVertexBuffer(0), textureIndexBuffer(0), whiteTexture(0), textureArray(0), textureArrayUnit(0), textureShader(nullptr),
+      circleVertexArray(0), circleVertexBuffer(0), circleIndexBuffer(0), circleShader(nullptr),
+      lineVertexArray(0), lineVertexBuffer(0), lineShader(nullptr),
+      quadInstanceVertexArray(0), quadInstanceBuffer(0), textureInstancedShader(nullptr),
+      circleInstanceVertexArray(0), circleInstanceBuffer(0), circleInstancedShader(nullptr),
+      frameTimers(), isFrameTimerPending(), frameTimer(0), oldestFrameTimer(0)
+  {
+    if (streaming && !this->streaming)
+      FLECTRON_LOG_WARN("Persistent buffer mapping is not supported, falling back to buffer uploads");
+
+    initTextureRendering();
+    initCircleRendering();
+    initLineRendering();
+    initInstancedRendering();
+    frameBuffer = createFrameBuffer(width, height, buffer);
+    initCamera();
+    glGenQueries((GLsizei)FrameTimerCount, frameTimers);
+  }
+
+  OpenGLRendererBackend::~OpenGLRendererBackend()
+  {
+    while (!staticBatches.empty())
+      destroyStaticBatch(staticBatches.begin()->first);
+
+    textureVertexStream.destroy();
+    textureIndexStream.destroy();
+    circleVertexStream.destroy();
+    lineVertexStream.destroy();
+
+    glDeleteVertexArrays(1, &textureVertexArray);
+    glDeleteBuffers(1, &textureVertexBuffer);
+    glDeleteBuffers(1, &textureIndexBuffer);
+    glDeleteTextures(1, &whiteTexture);
+
+    glDeleteVertexArrays(1, &circleVertexArray);
+    glDeleteBuffers(1, &circleVertexBuffer);
+    glDeleteBuffers(1, &circleIndexBuffer);
+
+    glDeleteVertexArrays(1, &lineVertexArray);
+    glDeleteBuffers(1, &lineVertexBuffer);
+
+    glDeleteVertexArrays(1, &quadInstanceVertexArray);
+    glDeleteBuffers(1, &quadInstanceBuffer);
+    glDeleteVertexArrays(1, &circleInstanceVertexArray);
+    glDeleteBuffers(1, &circleInstanceBuffer);
+
+    glDeleteQueries((GLsizei)FrameTimerCount, frameTimers);
+
+    if (frameBuffer != 0)
+      glDeleteFramebuffers(1, &frameBuffer);
+
+    glDeleteBuffers(1, &cameraUniformBuffer);
+
+    textureShaderVertex.unload();
+    textureShaderFragment.unload();
+
+    circleShaderVertex.unload();
+    circleShaderFragment.unload();
+
+    lineShaderVertex.unload();
+    lineShaderFragment.unload();
+
+    textureInstancedShaderVertex.unload();
+    circleInstancedShaderVertex.unload();
+  }
+
+  // Expects the vertex array and its vertex buffer to be bound
+  void OpenGLRendererBackend::setTextureAttributes(GLuint vertexArray)
+  {
+    glEnableVertexArrayAttrib(vertexArray, 0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, position));
+
+    glEnableVertexArrayAttrib(vertexArray, 1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, color));
+
+    glEnableVertexArrayAttrib(vertexArray, 2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, textureCoord));
+
+    glEnableVertexArrayAttrib(vertexArray, 3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, textureIndex));
+
+    glEnableVertexArrayAttrib(vertexArray, 4);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, tilingFactor));
+  }
+
+  void OpenGLRendererBackend::setCircleAttributes(GLuint vertexArray)
+  {
+    glEnableVertexArrayAttrib(vertexArray, 0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, worldPosition));
+
+    glEnableVertexArrayAttrib(vertexArray, 1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, localPosition));
+
+    glEnableVertexArrayAttrib(vertexArray, 2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, color));
+
+    glEnableVertexArrayAttrib(vertexArray, 3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, fade));
+
+    glEnableVertexArrayAttrib(vertexArray, 4);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, thickness));
+  }
+
+  void OpenGLRendererBackend::setLineAttributes(GLuint vertexArray)
+  {
+    glEnableVertexArrayAttrib(vertexArray, 0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (const void*)offsetof(LineVertex, position));
+
+    glEnableVertexArrayAttrib(vertexArray, 1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (const void*)offsetof(LineVertex, color));
+  }
+
+  void OpenGLRendererBackend::initTextureRendering()
+  {
+    glCreateVertexArrays(1, &textureVertexArray);
+    glBindVertexArray(textureVertexArray);
+
+    glCreateBuffers(1, &textureVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, textureVertexBuffer);
+    if (streaming)
+      textureVertexStream.create(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(TextureVertex));
+    else
+      glBufferData(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(TextureVertex), nullptr, GL_DYNAMIC_DRAW);
+
+    setTextureAttributes(textureVertexArray);
+
+    glGenBuffers(1, &textureIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, textureIndexBuffer);
+    if (streaming)
+      textureIndexStream.create(GL_ELEMENT_ARRAY_BUFFER, MaxIndexCount * sizeof(uint32_t));
+    else
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, MaxIndexCount * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+
+    // The last unit is kept for the texture array and the fragment shader declares 32 samplers
+    GLint textureUnits;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &textureUnits);
+    maxTextureSlots = std::min((size_t)textureUnits - 1, (size_t)32);
+    textureArrayUnit = (GLuint)maxTextureSlots;
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &whiteTexture);
+    glBindTexture(GL_TEXTURE_2D, whiteTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    uint32_t white = 0xffffffff;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+
+    int* samplers = new int[maxTextureSlots];
+    for (size_t i = 0; i < maxTextureSlots; i++)
+      samplers[i] = (int)i;
+
+    textureShaderVertex = Text::fromEmbed(FLECTRON_SHADER_TEXTURE_VERT());
+    textureShaderVertex.load();
+
+    textureShaderFragment = Text::fromEmbed(FLECTRON_SHADER_TEXTURE_FRAG());
+    textureShaderFragment.load();
+
+    textureShader = Shader::create({
+      textureShaderVertex,
+      nullptr,
+      textureShaderFragment,
+      nullptr
+    });
+    textureShader->bind();
+    textureShader->setUniform1iv("uTextures", samplers, (int)maxTextureSlots);
+    textureShader->setUniform1i("uTextureArray", (int)textureArrayUnit);
+    textureShader->setUniform1f("uZIndex", 0.3f);
+
+    delete[] samplers;
+  }
+
+  void OpenGLRendererBackend::initCircleRendering()
+  {
+    glCreateVertexArrays(1, &circleVertexArray);
+    glBindVertexArray(circleVertexArray);
+
+    glCreateBuffers(1, &circleVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, circleVertexBuffer);
+    if (streaming)
+      circleVertexStream.create(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(CircleVertex));
+    else
+      glBufferData(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(CircleVertex), nullptr, GL_DYNAMIC_DRAW);
+
+    setCircleAttributes(circleVertexArray);
+
+    uint32_t* indices = new uint32_t[MaxIndexCount];
+    uint32_t offset = 0;
+
+    for (uint32_t i = 0; i < MaxIndexCount; i += 6)
+    {
+      indices[i + 0] = offset + 0;
+      indices[i + 1] = offset + 1;
+      indices[i + 2] = offset + 2;
+
+      indices[i + 3] = offset + 2;
+      indices[i + 4] = offset + 3;
+      indices[i + 5] = offset + 0;
+
+      offset += 4;
+    }
+
+    glCreateBuffers(1, &circleIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, circleIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, MaxIndexCount * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+
+    delete[] indices;
+
+    circleShaderVertex = Text::fromEmbed(FLECTRON_SHADER_CIRCLE_VERT());
+    circleShaderVertex.load();
+
+    circleShaderFragment = Text::fromEmbed(FLECTRON_SHADER_CIRCLE_FRAG());
+    circleShaderFragment.load();
+
+    circleShader = Shader::create({
+      circleShaderVertex,
+      nullptr,
+      circleShaderFragment,
+      nullptr
+    });
+    circleShader->bind();
+    circleShader->setUniform1f("uZIndex", 0.2f);
+  }
+
+  void OpenGLRendererBackend::initLineRendering()
+  {
+    glCreateVertexArrays(1, &lineVertexArray);
+    glBindVertexArray(lineVertexArray);
+
+    glCreateBuffers(1, &lineVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, lineVertexBuffer);
+    if (streaming)
+      lineVertexStream.create(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(LineVertex));
+    else
+      glBufferData(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(LineVertex), nullptr, GL_DYNAMIC_DRAW);
+
+    setLineAttributes(lineVertexArray);
+
+    lineShaderVertex = Text::fromEmbed(FLECTRON_SHADER_LINE_VERT());
+    lineShaderVertex.load();
+
+    lineShaderFragment = Text::fromEmbed(FLECTRON_SHADER_LINE_FRAG());
+    lineShaderFragment.load();
+
+    lineShader = Shader::create({
+      lineShaderVertex,
+      nullptr,
+      lineShaderFragment,
+      nullptr
+    });
+    lineShader->bind();
+    lineShader->setUniform1f("uZIndex", 0.1f);
+  }
+
+  void OpenGLRendererBackend::initInstancedRendering()
+  {
+    glCreateVertexArrays(1, &quadInstanceVertexArray);
+    glBindVertexArray(quadInstanceVertexArray);
+
+    glCreateBuffers(1, &quadInstanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, quadInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, MaxInstanceCount * sizeof(QuadInstance), nullptr, GL_DYNAMIC_DRAW);
+
+    for (GLuint i = 0; i < 4; i++)
+    {
+      glEnableVertexArrayAttrib(quadInstanceVertexArray, i);
+      glVertexAttribPointer(i, 2, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (const void*)(offsetof(QuadInstance, corners) + i * sizeof(glm::vec2)));
+    }
+
+    glEnableVertexArrayAttrib(quadInstanceVertexArray, 4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (const void*)offsetof(QuadInstance, texturePosition));
+
+    glEnableVertexArrayAttrib(quadInstanceVertexArray, 5);
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (const void*)offsetof(QuadInstance, color));
+
+    glEnableVertexArrayAttrib(quadInstanceVertexArray, 6);
+    glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (const void*)offsetof(QuadInstance, textureIndex));
+
+    glEnableVertexArrayAttrib(quadInstanceVertexArray, 7);
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (const void*)offsetof(QuadInstance, tilingFactor));
+
+    for (GLuint i = 0; i < 8; i++)
+      glVertexAttribDivisor(i, 1);
+
+    glCreateVertexArrays(1, &circleInstanceVertexArray);
+    glBindVertexArray(circleInstanceVertexArray);
+
+    glCreateBuffers(1, &circleInstanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, circleInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, MaxInstanceCount * sizeof(CircleInstance), nullptr, GL_DYNAMIC_DRAW);
+
+    for (GLuint i = 0; i < 4; i++)
+    {
+      glEnableVertexArrayAttrib(circleInstanceVertexArray, i);
+      glVertexAttribPointer(i, 2, GL_FLOAT, GL_FALSE, sizeof(CircleInstance), (const void*)(offsetof(CircleInstance, corners) + i * sizeof(glm::vec2)));
+    }
+
+    glEnableVertexArrayAttrib(circleInstanceVertexArray, 4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(CircleInstance), (const void*)offsetof(CircleInstance, color));
+
+    glEnableVertexArrayAttrib(circleInstanceVertexArray, 5);
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(CircleInstance), (const void*)offsetof(CircleInstance, thickness));
+
+    glEnableVertexArrayAttrib(circleInstanceVertexArray, 6);
+    glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(CircleInstance), (const void*)offsetof(CircleInstance, fade));
+
+    for (GLuint i = 0; i < 7; i++)
+      glVertexAttribDivisor(i, 1);
+
+    // The instanced shaders share the fragment stages of the regular ones
+    textureInstancedShaderVertex = Text::fromEmbed(FLECTRON_SHADER_TEXTURE_INSTANCED_VERT());
+    textureInstancedShaderVertex.load();
+
+    textureInstancedShader = Shader::create({
+      textureInstancedShaderVertex,
+      nullptr,
+      textureShaderFragment,
+      nullptr
+    });
+
+    int* samplers = new int[maxTextureSlots];
+    for (size_t i = 0; i < maxTextureSlots; i++)
+      samplers[i] = (int)i;
+
+    textureInstancedShader->bind();
+    textureInstancedShader->setUniform1iv("uTextures", samplers, (int)maxTextureSlots);
+    textureInstancedShader->setUniform1i("uTextureArray", (int)textureArrayUnit);
+    textureInstancedShader->setUniform1f("uZIndex", 0.3f);
+
+    delete[] samplers;
+
+    circleInstancedShaderVertex = Text::fromEmbed(FLECTRON_SHADER_CIRCLE_INSTANCED_VERT());
+    circleInstancedShaderVertex.load();
+
+    circleInstancedShader = Shader::create({
+      circleInstancedShaderVertex,
+      nullptr,
+      circleShaderFragment,
+      nullptr
+    });
+    circleInstancedShader->bind();
+    circleInstancedShader->setUniform1f("uZIndex", 0.2f);
+  }
+
+  void OpenGLRendererBackend::initCamera()
+  {
+    glGenBuffers(1, &cameraUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+  }
+
+  size_t OpenGLRendererBackend::getMaxTextureSlots() const
+  {
+    return maxTextureSlots;
+  }
+
+  uint32_t OpenGLRendererBackend::getWhiteTexture() const
+  {
+    return whiteTexture;
+  }
+
+  void OpenGLRendererBackend::setViewProjectionMatrix(const glm::mat4& viewProjection)
+  {
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), glm::value_ptr(viewProjection), GL_DYNAMIC_DRAW);
+  }
+
+  void OpenGLRendererBackend::onscreen()
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
+  void OpenGLRendererBackend::offscreen()
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+  }
+
+  void OpenGLRendererBackend::setTextureArray(uint32_t textureArray)
+  {
+    this->textureArray = textureArray;
+  }
+
+  TextureVertex* OpenGLRendererBackend::mapTextureVertices()
+  {
+    return streaming ? (TextureVertex*)textureVertexStream.map() : nullptr;
+  }
+
+  uint32_t* OpenGLRendererBackend::mapTextureIndices()
+  {
+    return streaming ? (uint32_t*)textureIndexStream.map() : nullptr;
+  }
+
+  CircleVertex* OpenGLRendererBackend::mapCircleVertices()
+  {
+    return streaming ? (CircleVertex*)circleVertexStream.map() : nullptr;
+  }
+
+  LineVertex* OpenGLRendererBackend::mapLineVertices()
+  {
+    return streaming ? (LineVertex*)lineVertexStream.map() : nullptr;
+  }
+
+  void OpenGLRendererBackend::drawTextures(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const uint32_t* textureSlots, size_t textureSlotCount)
+  {
+    textureShader->bind();
+    textureShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+
+    glBindVertexArray(textureVertexArray);
+
+    for (uint32_t i = 0; i < textureSlotCount; i++)
+      glBindTextureUnit(i, textureSlots[i]);
+    if (textureArray != 0)
+      glBindTextureUnit(textureArrayUnit, textureArray);
+
+    if (streaming)
+    {
+      // The batch was written straight into the current regions
+      const GLint baseVertex = (GLint)(textureVertexStream.region * MaxVertexCount);
+      glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, (const void*)textureIndexStream.offset(), baseVertex);
+      textureVertexStream.fence();
+      textureIndexStream.fence();
+      return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, textureVertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertexCount * sizeof(TextureVertex), vertices);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, textureIndexBuffer);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * sizeof(uint32_t), indices);
+
+    glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, nullptr);
+  }
+
+  void OpenGLRendererBackend::drawCircles(const CircleVertex* vertices, size_t vertexCount)
+  {
+    circleShader->bind();
+    circleShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+
+    glBindVertexArray(circleVertexArray);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, circleIndexBuffer);
+
+    if (streaming)
+    {
+      const GLint baseVertex = (GLint)(circleVertexStream.region * MaxVertexCount);
+      glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)(vertexCount / 4 * 6), GL_UNSIGNED_INT, nullptr, baseVertex);
+      circleVertexStream.fence();
+      return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, circleVertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertexCount * sizeof(CircleVertex), vertices);
+
+    glDrawElements(GL_TRIANGLES, (GLsizei)(vertexCount / 4 * 6), GL_UNSIGNED_INT, nullptr);
+  }
+
+  void OpenGLRendererBackend::drawLines(const LineVertex* vertices, size_t vertexCount)
+  {
+    lineShader->bind();
+    lineShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+
+    glBindVertexArray(lineVertexArray);
+
+    if (streaming)
+    {
+      glDrawArrays(GL_TRIANGLE_STRIP, (GLint)(lineVertexStream.region * MaxVertexCount), (GLsizei)vertexCount);
+      lineVertexStream.fence();
+      return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, lineVertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertexCount * sizeof(LineVertex), vertices);
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, (GLsizei)vertexCount);
+  }
+
+  bool OpenGLRendererBackend::supportsInstancing() const
+  {
+    return true;
+  }
+
+  void OpenGLRendererBackend::drawQuadInstances(const QuadInstance* instances, size_t instanceCount, const uint32_t* textureSlots, size_t textureSlotCount)
+  {
+    textureInstancedShader->bind();
+    textureInstancedShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+
+    glBindVertexArray(quadInstanceVertexArray);
+
+    for (uint32_t i = 0; i < textureSlotCount; i++)
+      glBindTextureUnit(i, textureSlots[i]);
+    if (textureArray != 0)
+      glBindTextureUnit(textureArrayUnit, textureArray);
+
+    glBindBuffer(GL_ARRAY_BUFFER, quadInstanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(QuadInstance), instances);
+
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)instanceCount);
+  }
+
+  // Everything is uploaded once, the segments are then drawn as ranges of the same buffers
+  void OpenGLRendererBackend::drawTextureSegments(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const QuadInstance* instances, size_t instanceCount, const TextureSegment* segments, size_t segmentCount, const uint32_t* textureSlots, size_t textureSlotCount)
+  {
+    for (uint32_t i = 0; i < textureSlotCount; i++)
+      glBindTextureUnit(i, textureSlots[i]);
+    if (textureArray != 0)
+      glBindTextureUnit(textureArrayUnit, textureArray);
+
+    size_t indexOffset = 0;
+    GLint baseVertex = 0;
+    if (streaming)
+    {
+      indexOffset = textureIndexStream.offset();
+      baseVertex = (GLint)(textureVertexStream.region * MaxVertexCount);
+    }
+    else if (indexCount != 0)
+    {
+      glBindVertexArray(textureVertexArray);
+      glBindBuffer(GL_ARRAY_BUFFER, textureVertexBuffer);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, vertexCount * sizeof(TextureVertex), vertices);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, textureIndexBuffer);
+      glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * sizeof(uint32_t), indices);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, quadInstanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(QuadInstance), instances);
+
+    textureShader->bind();
+    textureShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+    textureInstancedShader->bind();
+    textureInstancedShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+
+    for (size_t i = 0; i < segmentCount; i++)
+    {
+      const TextureSegment& segment = segments[i];
+      if (segment.isInstanced)
+      {
+        textureInstancedShader->bind();
+        glBindVertexArray(quadInstanceVertexArray);
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, (GLsizei)segment.count, segment.first);
+      }
+      else
+      {
+        textureShader->bind();
+        glBindVertexArray(textureVertexArray);
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)segment.count, GL_UNSIGNED_INT, (const void*)(indexOffset + segment.first * sizeof(uint32_t)), baseVertex);
+      }
+    }
+
+    if (streaming && indexCount != 0)
+    {
+      textureVertexStream.fence();
+      textureIndexStream.fence();
+    }
+  }
+
+  void OpenGLRendererBackend::drawCircleInstances(const CircleInstance* instances, size_t instanceCount)
+  {
+    circleInstancedShader->bind();
+    circleInstancedShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+
+    glBindVertexArray(circleInstanceVertexArray);
+
+    glBindBuffer(GL_ARRAY_BUFFER, circleInstanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(CircleInstance), instances);
+
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)instanceCount);
+  }
+
+  uint32_t OpenGLRendererBackend::createStaticBatch(const RecordedBatches& batches)
+  {
+    StaticBatch batch;
+    batch.drawCalls = batches.drawCalls;
+
+    if (!batches.textureVertices.empty())
+    {
+      glCreateVertexArrays(1, &batch.textureVertexArray);
+      glBindVertexArray(batch.textureVertexArray);
+
+      glCreateBuffers(1, &batch.textureVertexBuffer);
+      glBindBuffer(GL_ARRAY_BUFFER, batch.textureVertexBuffer);
+      glBufferData(GL_ARRAY_BUFFER, batches.textureVertices.size() * sizeof(TextureVertex), batches.textureVertices.data(), GL_STATIC_DRAW);
+      setTextureAttributes(batch.textureVertexArray);
+
+      glCreateBuffers(1, &batch.textureIndexBuffer);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.textureIndexBuffer);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, batches.textureIndices.size() * sizeof(uint32_t), batches.textureIndices.data(), GL_STATIC_DRAW);
+    }
+
+    if (!batches.circleVertices.empty())
+    {
+      glCreateVertexArrays(1, &batch.circleVertexArray);
+      glBindVertexArray(batch.circleVertexArray);
+
+      glCreateBuffers(1, &batch.circleVertexBuffer);
+      glBindBuffer(GL_ARRAY_BUFFER, batch.circleVertexBuffer);
+      glBufferData(GL_ARRAY_BUFFER, batches.circleVertices.size() * sizeof(CircleVertex), batches.circleVertices.data(), GL_STATIC_DRAW);
+      setCircleAttributes(batch.circleVertexArray);
+
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, circleIndexBuffer);
+    }
+
+    if (!batches.lineVertices.empty())
+    {
+      glCreateVertexArrays(1, &batch.lineVertexArray);
+      glBindVertexArray(batch.lineVertexArray);
+
+      glCreateBuffers(1, &batch.lineVertexBuffer);
+      glBindBuffer(GL_ARRAY_BUFFER, batch.lineVertexBuffer);
+      glBufferData(GL_ARRAY_BUFFER, batches.lineVertices.size() * sizeof(LineVertex), batches.lineVertices.data(), GL_STATIC_DRAW);
+      setLineAttributes(batch.lineVertexArray);
+    }
+
+    const uint32_t id = nextStaticBatch++;
+    staticBatches.emplace(id, std::move(batch));
+    return id;
+  }
+
+  // Every recorded batch becomes one draw call over the retained buffers
+  void OpenGLRendererBackend::drawStaticBatch(uint32_t id)
+  {
+    auto it = staticBatches.find(id);
+    FLECTRON_ASSERT(it != staticBatches.end(), "Static batch does not exist");
+    const StaticBatch& batch = it->second;
+
+    for (const auto& drawCall : batch.drawCalls)
+    {
+      switch (drawCall.type)
+      {
+      case RecordedBatches::BatchType::Texture:
+        textureShader->bind();
+        textureShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+        glBindVertexArray(batch.textureVertexArray);
+        for (uint32_t i = 0; i < drawCall.textureSlots.size(); i++)
+          glBindTextureUnit(i, drawCall.textureSlots[i]);
+        if (textureArray != 0)
+          glBindTextureUnit(textureArrayUnit, textureArray);
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)drawCall.indexCount, GL_UNSIGNED_INT, (const void*)(drawCall.indexOffset * sizeof(uint32_t)), (GLint)drawCall.vertexOffset);
+        break;
+      case RecordedBatches::BatchType::Circle:
+        circleShader->bind();
+        circleShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+        glBindVertexArray(batch.circleVertexArray);
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)drawCall.indexCount, GL_UNSIGNED_INT, nullptr, (GLint)drawCall.vertexOffset);
+        break;
+      case RecordedBatches::BatchType::Line:
+        lineShader->bind();
+        lineShader->setUniformBlock(CameraBlock, cameraUniformBuffer);
+        glBindVertexArray(batch.lineVertexArray);
+        glDrawArrays(GL_TRIANGLE_STRIP, (GLint)drawCall.vertexOffset, (GLsizei)drawCall.vertexCount);
+        break;
+      default:
+        FLECTRON_LOG_WARN("Static batches only retain vertex batches");
+        break;
+      }
+    }
+  }
+
+  void OpenGLRendererBackend::destroyStaticBatch(uint32_t id)
+  {
+    auto it = staticBatches.find(id);
+    if (it == staticBatches.end())
+      return;
+
+    StaticBatch& batch = it->second;
+    glDeleteVertexArrays(1, &batch.textureVertexArray);
+    glDeleteBuffers(1, &batch.textureVertexBuffer);
+    glDeleteBuffers(1, &batch.textureIndexBuffer);
+    glDeleteVertexArrays(1, &batch.circleVertexArray);
+    glDeleteBuffers(1, &batch.circleVertexBuffer);
+    glDeleteVertexArrays(1, &batch.lineVertexArray);
+    glDeleteBuffers(1, &batch.lineVertexBuffer);
+    staticBatches.erase(it);
+  }
+
+  void OpenGLRendererBackend::beginFrameTimer()
+  {
+    // A query that was never read back is dropped rather than waited for
+    if (isFrameTimerPending[frameTimer])
+    {
+      isFrameTimerPending[frameTimer] = false;
+      oldestFrameTimer = (frameTimer + 1) % FrameTimerCount;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, frameTimers[frameTimer]);
+  }
+
+  void OpenGLRendererBackend::endFrameTimer()
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+    isFrameTimerPending[frameTimer] = true;
+    frameTimer = (frameTimer + 1) % FrameTimerCount;
+  }
+
+  bool OpenGLRendererBackend::getFrameTime(float& milliseconds)
+  {
+    bool isAvailable = false;
+    while (isFrameTimerPending[oldestFrameTimer])
+    {
+      GLint available = GL_FALSE;
+      glGetQueryObjectiv(frameTimers[oldestFrameTimer], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available == GL_FALSE)
+        break;
+
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(frameTimers[oldestFrameTimer], GL_QUERY_RESULT, &nanoseconds);
+      milliseconds = (float)((double)nanoseconds / 1e6);
+      isAvailable = true;
+
+      isFrameTimerPending[oldestFrameTimer] = false;
+      oldestFrameTimer = (oldestFrameTimer + 1) % FrameTimerCount;
+    }
+    return isAvailable;
+  }
+
+  RecordingRendererBackend::RecordingRendererBackend(size_t maxTextureSlots, uint32_t whiteTexture)
+    : RecordedBatches(), viewProjection(1.0f), isOffscreen(false), textureArray(0), staticBatches(),
+      maxTextureSlots(maxTextureSlots), whiteTexture(whiteTexture), nextStaticBatch(1)
+  {}
+
+  void RecordingRendererBackend::reset()
+  {
+    textureVertices.clear();
+    textureIndices.clear();
+    circleVertices.clear();
+    lineVertices.clear();
+    quadInstances.clear();
+    circleInstances.clear();
+    drawCalls.clear();
+  }
+
+  size_t RecordingRendererBackend::getMaxTextureSlots() const
+  {
+    return maxTextureSlots;
+  }
+
+  uint32_t RecordingRendererBackend::getWhiteTexture() const
+  {
+    return whiteTexture;
+  }
+
+  void RecordingRendererBackend::setViewProjectionMatrix(const glm::mat4& viewProjection)
+  {
+    this->viewProjection = viewProjection;
+  }
+
+  void RecordingRendererBackend::onscreen()
+  {
+    isOffscreen = false;
+  }
+
+  void RecordingRendererBackend::offscreen()
+  {
+    isOffscreen = true;
+  }
+
+  void RecordingRendererBackend::setTextureArray(uint32_t textureArray)
+  {
+    this->textureArray = textureArray;
+  }
+
+  void RecordingRendererBackend::drawTextures(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const uint32_t* textureSlots, size_t textureSlotCount)
+  {
+    drawCalls.push_back({ BatchType::Texture, textureVertices.size(), vertexCount, textureIndices.size(), indexCount, { textureSlots, textureSlots + textureSlotCount } });
+    textureVertices.insert(textureVertices.end(), vertices, vertices + vertexCount);
+    textureIndices.insert(textureIndices.end(), indices, indices + indexCount);
+  }
+
+  void RecordingRendererBackend::drawCircles(const CircleVertex* vertices, size_t vertexCount)
+  {
+    drawCalls.push_back({ BatchType::Circle, circleVertices.size(), vertexCount, 0, vertexCount / 4 * 6, {} });
+    circleVertices.insert(circleVertices.end(), vertices, vertices + vertexCount);
+  }
+
+  void RecordingRendererBackend::drawLines(const LineVertex* vertices, size_t vertexCount)
+  {
+    drawCalls.push_back({ BatchType::Line, lineVertices.size(), vertexCount, 0, 0, {} });
+    lineVertices.insert(lineVertices.end(), vertices, vertices + vertexCount);
+  }
+
+  bool RecordingRendererBackend::supportsInstancing() const
+  {
+    return true;
+  }
+
+  void RecordingRendererBackend::drawQuadInstances(const QuadInstance* instances, size_t instanceCount, const uint32_t* textureSlots, size_t textureSlotCount)
+  {
+    drawCalls.push_back({ BatchType::QuadInstances, quadInstances.size(), instanceCount, 0, 0, { textureSlots, textureSlots + textureSlotCount } });
+    quadInstances.insert(quadInstances.end(), instances, instances + instanceCount);
+  }
+
+  void RecordingRendererBackend::drawCircleInstances(const CircleInstance* instances, size_t instanceCount)
+  {
+    drawCalls.push_back({ BatchType::CircleInstances, circleInstances.size(), instanceCount, 0, 0, {} });
+    circleInstances.insert(circleInstances.end(), instances, instances + instanceCount);
+  }
+
+  // Recorded like the separate draws it stands for, each segment points into the vertices, indices and instances uploaded once
+  void RecordingRendererBackend::drawTextureSegments(const TextureVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, const QuadInstance* instances, size_t instanceCount, const TextureSegment* segments, size_t segmentCount, const uint32_t* textureSlots, size_t textureSlotCount)
+  {
+    const size_t vertexOffset = textureVertices.size();
+    const size_t indexOffset = textureIndices.size();
+    const size_t instanceOffset = quadInstances.size();
+    textureVertices.insert(textureVertices.end(), vertices, vertices + vertexCount);
+    textureIndices.insert(textureIndices.end(), indices, indices + indexCount);
+    quadInstances.insert(quadInstances.end(), instances, instances + instanceCount);
+
+    for (size_t i = 0; i < segmentCount; i++)
+    {
+      const TextureSegment& segment = segments[i];
+      if (segment.isInstanced)
+        drawCalls.push_back({ BatchType::QuadInstances, instanceOffset + segment.first, segment.count, 0, 0, { textureSlots, textureSlots + textureSlotCount } });
+      else
+        drawCalls.push_back({ BatchType::Texture, vertexOffset, vertexCount, indexOffset + segment.first, segment.count, { textureSlots, textureSlots + textureSlotCount } });
+    }
+  }
+
+  uint32_t RecordingRendererBackend::createStaticBatch(const RecordedBatches& batches)
+  {
+    const uint32_t id = nextStaticBatch++;
+    staticBatches.emplace(id, batches);
+    return id;
+  }
+
+  void RecordingRendererBackend::drawStaticBatch(uint32_t batch)
+  {
+    FLECTRON_ASSERT(staticBatches.count(batch) != 0, "Static batch does not exist");
+    drawCalls.push_back({ BatchType::Static, batch, 0, 0, 0, {} });
+  }
+
+  void RecordingRendererBackend::destroyStaticBatch(uint32_t batch)
+  {
+    staticBatches.erase(batch);
+  }
+
+}
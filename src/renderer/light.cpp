@@ -3,22 +3,159 @@
 #include <flectron/assert/assert.hpp>
 #include <flectron/utils/embed.hpp>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <cmath>
+
 FLECTRON_EMBED(FLECTRON_SHADER_LIGHT_VERT);
 FLECTRON_EMBED(FLECTRON_SHADER_LIGHT_FRAG);
+FLECTRON_EMBED(FLECTRON_SHADER_LIGHT_SPRITE_VERT);
+FLECTRON_EMBED(FLECTRON_SHADER_LIGHT_SPRITE_FRAG);
+FLECTRON_EMBED(FLECTRON_SHADER_LIGHT_COMPOSITE_FRAG);
 
 namespace flectron
 {
 
-  LightRenderer::LightRenderer()
-    : vertexSource(Text::fromEmbed(FLECTRON_SHADER_LIGHT_VERT())),
+  LightTiles::LightTiles()
+    : data(Columns * Rows * 2, 0)
+  {}
+
+  // Calls back with every tile the light circle overlaps
+  template<typename Callback>
+  static void forEachTile(const Light& light, const glm::vec2& min, const glm::vec2& tileSize, Callback callback)
+  {
+    const int left = (int)std::floor((light.position.x - light.radius - min.x) / tileSize.x);
+    const int right = (int)std::floor((light.position.x + light.radius - min.x) / tileSize.x);
+    const int bottom = (int)std::floor((light.position.y - light.radius - min.y) / tileSize.y);
+    const int top = (int)std::floor((light.position.y + light.radius - min.y) / tileSize.y);
+
+    for (int row = std::max(bottom, 0); row <= std::min(top, LightTiles::Rows - 1); row++)
+    {
+      for (int column = std::max(left, 0); column <= std::min(right, LightTiles::Columns - 1); column++)
+      {
+        const float tileX = min.x + (float)column * tileSize.x;
+        const float tileY = min.y + (float)row * tileSize.y;
+        const float dx = light.position.x - std::max(tileX, std::min(light.position.x, tileX + tileSize.x));
+        const float dy = light.position.y - std::max(tileY, std::min(light.position.y, tileY + tileSize.y));
+        if (dx * dx + dy * dy < light.radius * light.radius)
+          callback(row * LightTiles::Columns + column);
+      }
+    }
+  }
+
+  void LightTiles::build(const Light* lights, int lightCount, const glm::vec2& min, const glm::vec2& size)
+  {
+    const int tileCount = Columns * Rows;
+    data.assign(tileCount * 2, 0);
+    if (size.x <= 0.0f || size.y <= 0.0f)
+      return;
+
+    const glm::vec2 tileSize(size.x / (float)Columns, size.y / (float)Rows);
+
+    for (int i = 0; i < lightCount; i++)
+      forEachTile(lights[i], min, tileSize, [&](int tile) { data[tile * 2 + 1]++; });
+
+    int offset = tileCount * 2;
+    for (int tile = 0; tile < tileCount; tile++)
+    {
+      data[tile * 2] = offset;
+      offset += data[tile * 2 + 1];
+      data[tile * 2 + 1] = 0;
+    }
+    data.resize(offset);
+
+    for (int i = 0; i < lightCount; i++)
+      forEachTile(lights[i], min, tileSize, [&](int tile) { data[data[tile * 2] + data[tile * 2 + 1]++] = i; });
+  }
+
+  int LightTiles::getCount(int column, int row) const
+  {
+    return data[(row * Columns + column) * 2 + 1];
+  }
+
+  const int* LightTiles::getLights(int column, int row) const
+  {
+    return data.data() + data[(row * Columns + column) * 2];
+  }
+
+  const std::vector<int>& LightTiles::getData() const
+  {
+    return data;
+  }
+
+  void ShadowMap::clear(std::vector<float>& shadowMap)
+  {
+    shadowMap.assign(Resolution, 1.0f);
+  }
+
+  void ShadowMap::cast(std::vector<float>& shadowMap, const Vector& light, float radius, const Vector* vertices, size_t vertexCount)
+  {
+    FLECTRON_ASSERT(shadowMap.size() == (size_t)Resolution, "Shadow map has to be cleared first");
+    const float pi = (float)M_PI;
+    const float binAngle = 2.0f * pi / (float)Resolution;
+
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+      const Vector& next = vertices[(i + 1) % vertexCount];
+      const glm::vec2 a(vertices[i].x - light.x, vertices[i].y - light.y);
+      const glm::vec2 edge(next.x - vertices[i].x, next.y - vertices[i].y);
+      const float area = a.x * edge.y - a.y * edge.x;
+      if (std::abs(area) < 1e-6f)
+        continue;
+
+      // Only the bins pointing between the two ends of the edge can hit it
+      float start = std::atan2(a.y, a.x);
+      float span = std::atan2(a.y + edge.y, a.x + edge.x) - start;
+      if (span > pi)
+        span -= 2.0f * pi;
+      else if (span < -pi)
+        span += 2.0f * pi;
+      if (span < 0.0f)
+      {
+        start += span;
+        span = -span;
+      }
+
+      const int first = (int)std::ceil((start + pi) / binAngle - 0.5f);
+      const int last = (int)std::floor((start + span + pi) / binAngle - 0.5f);
+      for (int bin = first; bin <= last; bin++)
+      {
+        const float angle = ((float)bin + 0.5f) * binAngle - pi;
+        const float dx = std::cos(angle);
+        const float dy = std::sin(angle);
+        const float distance = area / (dx * edge.y - dy * edge.x);
+        if (distance <= 0.0f)
+          continue;
+
+        float& element = shadowMap[(bin % Resolution + Resolution) % Resolution];
+        element = std::min(element, distance / radius);
+      }
+    }
+  }
+
+  LightRenderer::LightRenderer(Mode mode, float lightMapScale)
+    : mode(mode),
+      vertexSource(Text::fromEmbed(FLECTRON_SHADER_LIGHT_VERT())),
       fragmentSource(Text::fromEmbed(FLECTRON_SHADER_LIGHT_FRAG())),
-      shader(nullptr),
-      currentLight(0), currentData(0), currentColor(0)
+      shader(nullptr), tiledUniforms(),
+      lights(FLECTRON_NUM_LIGHTS), currentLight(0), maxLights(FLECTRON_NUM_LIGHTS), droppedLights(0), uploadedLights(FLECTRON_NUM_LIGHTS),
+      shadowMaps((size_t)FLECTRON_NUM_LIGHTS * ShadowMap::Resolution, 1.0f), firstDirtyShadow(std::numeric_limits<int>::max()), lastDirtyShadow(0), shadowTexture(0),
+      tiles(), lightBuffer(0), lightTexture(0), tileBuffer(0), tileTexture(0),
+      spriteVertexSource(Text::fromEmbed(FLECTRON_SHADER_LIGHT_SPRITE_VERT())),
+      spriteFragmentSource(Text::fromEmbed(FLECTRON_SHADER_LIGHT_SPRITE_FRAG())),
+      compositeFragmentSource(Text::fromEmbed(FLECTRON_SHADER_LIGHT_COMPOSITE_FRAG())),
+      spriteShader(nullptr), compositeShader(nullptr), lightMapUniforms(),
+      spriteVao(0), lightMapFrameBuffer(0), lightMapColor(0), lightMapWeight(0), lightMapWidth(0), lightMapHeight(0), lightMapScale(lightMapScale)
   {
     FLECTRON_LOG_TRACE("Creating light renderer");
 
     vertexSource.load();
     fragmentSource.load();
+    spriteVertexSource.load();
+    spriteFragmentSource.load();
+    compositeFragmentSource.load();
 
     shader = Shader::create({
       vertexSource,
@@ -27,6 +164,20 @@ namespace flectron
       nullptr
     });
 
+    spriteShader = Shader::create({
+      spriteVertexSource,
+      nullptr,
+      spriteFragmentSource,
+      nullptr
+    });
+
+    compositeShader = Shader::create({
+      vertexSource,
+      nullptr,
+      compositeFragmentSource,
+      nullptr
+    });
+
     constexpr float positions[]{
       -1.0f, -1.0f,
       -1.0f,  1.0f,
@@ -53,8 +204,71 @@ namespace flectron
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
+    GLint maxTextureSize = 0;
+    GLint maxTextureBufferSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+    maxLights = std::max(FLECTRON_NUM_LIGHTS, std::min(maxTextureSize, maxTextureBufferSize / (int)(sizeof(Light) / (4 * sizeof(float)))));
+
+    glCreateBuffers(1, &lightBuffer);
+    glNamedBufferData(lightBuffer, uploadedLights.size() * sizeof(Light), uploadedLights.data(), GL_DYNAMIC_DRAW);
+    glCreateTextures(GL_TEXTURE_BUFFER, 1, &lightTexture);
+    glTextureBuffer(lightTexture, GL_RGBA32F, lightBuffer);
+
+    glCreateBuffers(1, &tileBuffer);
+    glNamedBufferData(tileBuffer, tiles.getData().size() * sizeof(int), nullptr, GL_DYNAMIC_DRAW);
+    glCreateTextures(GL_TEXTURE_BUFFER, 1, &tileTexture);
+    glTextureBuffer(tileTexture, GL_R32I, tileBuffer);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &shadowTexture);
+    glTextureStorage2D(shadowTexture, 1, GL_R16F, ShadowMap::Resolution, (GLsizei)lights.size());
+    glTextureSubImage2D(shadowTexture, 0, 0, 0, ShadowMap::Resolution, (GLsizei)lights.size(), GL_RED, GL_FLOAT, shadowMaps.data());
+
     shader->bind();
     shader->setUniform1i("uRendererTexture", 0);
+    shader->setUniform1i("uShadowMaps", 3);
+    shader->setUniform1i("uShadowResolution", ShadowMap::Resolution);
+    shader->setUniform1i("uLights", 1);
+    shader->setUniform1i("uTileLights", 2);
+    shader->setUniform1i("uTileColumns", LightTiles::Columns);
+    shader->setUniform1i("uTileRows", LightTiles::Rows);
+
+    tiledUniforms.cameraPosition = shader->getUniformLocation(UniformName("uCameraPosition"));
+    tiledUniforms.windowSize = shader->getUniformLocation(UniformName("uWindowSize"));
+    tiledUniforms.baseColor = shader->getUniformLocation(UniformName("uBaseColor"));
+    tiledUniforms.darkness = shader->getUniformLocation(UniformName("uDarkness"));
+
+    // Every light is an instance of the full screen quad scaled down to its radius
+    glGenVertexArrays(1, &spriteVao);
+    glBindVertexArray(spriteVao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (const void*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, lightBuffer);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Light), (const void*)offsetof(Light, position));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Light), (const void*)offsetof(Light, color));
+    glVertexAttribDivisor(2, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+    compositeShader->bind();
+    compositeShader->setUniform1i("uRendererTexture", 0);
+    compositeShader->setUniform1i("uLightMap", 1);
+    compositeShader->setUniform1i("uLightMapWeight", 2);
+
+    spriteShader->bind();
+    spriteShader->setUniform1i("uShadowMaps", 3);
+    spriteShader->setUniform1i("uShadowResolution", ShadowMap::Resolution);
+
+    lightMapUniforms.cameraPosition = spriteShader->getUniformLocation(UniformName("uCameraPosition"));
+    lightMapUniforms.windowSize = spriteShader->getUniformLocation(UniformName("uWindowSize"));
+    lightMapUniforms.baseColor = compositeShader->getUniformLocation(UniformName("uBaseColor"));
+    lightMapUniforms.darkness = compositeShader->getUniformLocation(UniformName("uDarkness"));
   }
 
   LightRenderer::~LightRenderer()
@@ -63,76 +277,251 @@ namespace flectron
     glDeleteBuffers(1, &vbo);
     glDeleteBuffers(1, &ibo);
     glDeleteVertexArrays(1, &vao);
+    glDeleteTextures(1, &lightTexture);
+    glDeleteBuffers(1, &lightBuffer);
+    glDeleteTextures(1, &tileTexture);
+    glDeleteBuffers(1, &tileBuffer);
+    glDeleteVertexArrays(1, &spriteVao);
+    glDeleteFramebuffers(1, &lightMapFrameBuffer);
+    glDeleteTextures(1, &lightMapColor);
+    glDeleteTextures(1, &lightMapWeight);
+    glDeleteTextures(1, &shadowTexture);
+  }
+
+  void LightRenderer::setMode(Mode mode)
+  {
+    this->mode = mode;
+  }
+
+  LightRenderer::Mode LightRenderer::getMode() const
+  {
+    return mode;
+  }
+
+  void LightRenderer::setLightMapScale(float scale)
+  {
+    FLECTRON_ASSERT(scale > 0.0f && scale <= 1.0f, "Light map scale has to be in (0, 1]");
+    lightMapScale = scale;
+  }
+
+  float LightRenderer::getLightMapScale() const
+  {
+    return lightMapScale;
   }
 
   void LightRenderer::reset()
   {
     currentLight = 0;
-    currentData = 0;
-    currentColor = 0;
+    droppedLights = 0;
   }
 
   void LightRenderer::render(const Color& baseColor, float darkness, const glm::vec3& cameraPosition, const glm::vec2& windowSize, GLuint rendererBuffer)
   {
     Renderer::endBatch();
 
-    shader->bind();
+    uploadLights();
+    glBindTextureUnit(3, shadowTexture);
+
+    if (mode == Mode::LightMap)
+      renderLightMap(baseColor, darkness, cameraPosition, windowSize, rendererBuffer);
+    else
+      renderTiled(baseColor, darkness, cameraPosition, windowSize, rendererBuffer);
+
+    reset();
+
+    Renderer::beginBatch();
+  }
+
+  // Both buffers keep one entry per light and are reallocated, the next upload then sends every light again
+  void LightRenderer::growLights()
+  {
+    const int capacity = std::min((int)lights.size() * 2, maxLights);
+    FLECTRON_LOG_DEBUG("Growing light buffers to {} lights", capacity);
+
+    lights.resize(capacity);
+    uploadedLights.assign(capacity, Light{});
+    glNamedBufferData(lightBuffer, uploadedLights.size() * sizeof(Light), uploadedLights.data(), GL_DYNAMIC_DRAW);
+    glTextureBuffer(lightTexture, GL_RGBA32F, lightBuffer);
+
+    shadowMaps.resize((size_t)capacity * ShadowMap::Resolution, 1.0f);
+    glDeleteTextures(1, &shadowTexture);
+    glCreateTextures(GL_TEXTURE_2D, 1, &shadowTexture);
+    glTextureStorage2D(shadowTexture, 1, GL_R16F, ShadowMap::Resolution, capacity);
+    glTextureSubImage2D(shadowTexture, 0, 0, 0, ShadowMap::Resolution, capacity, GL_RED, GL_FLOAT, shadowMaps.data());
+    firstDirtyShadow = std::numeric_limits<int>::max();
+    lastDirtyShadow = 0;
+  }
+
+  // Lights that kept their place in the list since the last frame are not uploaded again
+  void LightRenderer::uploadLights()
+  {
+    int first = 0;
+    while (first < currentLight && std::memcmp(&lights[first], &uploadedLights[first], sizeof(Light)) == 0)
+      first++;
+
+    int last = currentLight;
+    while (last > first && std::memcmp(&lights[last - 1], &uploadedLights[last - 1], sizeof(Light)) == 0)
+      last--;
+
+    if (first < last)
+    {
+      glNamedBufferSubData(lightBuffer, first * sizeof(Light), (last - first) * sizeof(Light), &lights[first]);
+      std::copy(&lights[first], &lights[last], &uploadedLights[first]);
+    }
+
+    if (firstDirtyShadow <= lastDirtyShadow)
+    {
+      glTextureSubImage2D(shadowTexture, 0, 0, firstDirtyShadow, ShadowMap::Resolution, lastDirtyShadow - firstDirtyShadow + 1, GL_RED, GL_FLOAT, &shadowMaps[(size_t)firstDirtyShadow * ShadowMap::Resolution]);
+      firstDirtyShadow = std::numeric_limits<int>::max();
+      lastDirtyShadow = 0;
+    }
+  }
+
+  void LightRenderer::renderTiled(const Color& baseColor, float darkness, const glm::vec3& cameraPosition, const glm::vec2& windowSize, GLuint rendererBuffer)
+  {
+    // Lights that reach no tile of the view are never evaluated
+    const glm::vec2 min(cameraPosition.x - windowSize.x * 0.5f, cameraPosition.y - windowSize.y * 0.5f);
+    tiles.build(lights.data(), currentLight, min, windowSize);
+
+    const auto& tileData = tiles.getData();
+    glNamedBufferData(tileBuffer, tileData.size() * sizeof(int), tileData.data(), GL_DYNAMIC_DRAW);
 
-    shader->setUniform2f("uCameraPosition", cameraPosition.x, cameraPosition.y);
-    shader->setUniform2f("uWindowSize", windowSize.x, windowSize.y);
-    shader->setUniform4f("uBaseColor", baseColor.r, baseColor.g, baseColor.b, baseColor.a);
+    shader->bind();
 
-    shader->setUniform4fv("uLightColor", lightsColors, currentLight);
-    shader->setUniform3fv("uLightData", lightsData, currentLight);
-    shader->setUniform1i("uLightCount", currentLight);
-    shader->setUniform1f("uDarkness", darkness);
+    shader->setUniform2f(tiledUniforms.cameraPosition, cameraPosition.x, cameraPosition.y);
+    shader->setUniform2f(tiledUniforms.windowSize, windowSize.x, windowSize.y);
+    shader->setUniform4f(tiledUniforms.baseColor, baseColor.r, baseColor.g, baseColor.b, baseColor.a);
+    shader->setUniform1f(tiledUniforms.darkness, darkness);
 
     Renderer::onscreen();
     glBindTextureUnit(0, rendererBuffer);
+    glBindTextureUnit(1, lightTexture);
+    glBindTextureUnit(2, tileTexture);
 
     glBindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+  }
 
-    reset();
+  void LightRenderer::renderLightMap(const Color& baseColor, float darkness, const glm::vec3& cameraPosition, const glm::vec2& windowSize, GLuint rendererBuffer)
+  {
+    int width = 0;
+    int height = 0;
+    glGetTextureLevelParameteriv(rendererBuffer, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(rendererBuffer, 0, GL_TEXTURE_HEIGHT, &height);
 
-    Renderer::beginBatch();
+    const int mapWidth = std::max(1, (int)((float)width * lightMapScale));
+    const int mapHeight = std::max(1, (int)((float)height * lightMapScale));
+    if (mapWidth != lightMapWidth || mapHeight != lightMapHeight)
+      resizeLightMap(mapWidth, mapHeight);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, lightMapFrameBuffer);
+    glViewport(0, 0, lightMapWidth, lightMapHeight);
+
+    const float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearNamedFramebufferfv(lightMapFrameBuffer, GL_COLOR, 0, clearColor);
+    glClearNamedFramebufferfv(lightMapFrameBuffer, GL_COLOR, 1, clearColor);
+
+    glBlendFunc(GL_ONE, GL_ONE);
+    glBlendEquationi(1, GL_MAX);
+
+    spriteShader->bind();
+    spriteShader->setUniform2f(lightMapUniforms.cameraPosition, cameraPosition.x, cameraPosition.y);
+    spriteShader->setUniform2f(lightMapUniforms.windowSize, windowSize.x, windowSize.y);
+
+    glBindVertexArray(spriteVao);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, currentLight);
+
+    // Back to the blending the window was set up with
+    glBlendEquationi(1, GL_FUNC_ADD);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    compositeShader->bind();
+    compositeShader->setUniform4f(lightMapUniforms.baseColor, baseColor.r, baseColor.g, baseColor.b, baseColor.a);
+    compositeShader->setUniform1f(lightMapUniforms.darkness, darkness);
+
+    Renderer::onscreen();
+    glBindTextureUnit(0, rendererBuffer);
+    glBindTextureUnit(1, lightMapColor);
+    glBindTextureUnit(2, lightMapWeight);
+
+    glBindVertexArray(vao);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
   }
 
-  void LightRenderer::addLight(const Vector& position, float radius, const Color& color)
+  void LightRenderer::resizeLightMap(int width, int height)
   {
-    FLECTRON_ASSERT(currentLight < FLECTRON_NUM_LIGHTS, "Too many lights");
+    FLECTRON_LOG_DEBUG("Resizing light map to {}x{}", width, height);
+    glDeleteFramebuffers(1, &lightMapFrameBuffer);
+    glDeleteTextures(1, &lightMapColor);
+    glDeleteTextures(1, &lightMapWeight);
+
+    lightMapWidth = width;
+    lightMapHeight = height;
 
-    lightsData[currentData++] = position.x;
-    lightsData[currentData++] = position.y;
-    lightsData[currentData++] = radius;
+    glCreateTextures(GL_TEXTURE_2D, 1, &lightMapColor);
+    glTextureStorage2D(lightMapColor, 1, GL_RGBA16F, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &lightMapWeight);
+    glTextureStorage2D(lightMapWeight, 1, GL_R16F, width, height);
 
-    lightsColors[currentColor++] = color.r;
-    lightsColors[currentColor++] = color.g;
-    lightsColors[currentColor++] = color.b;
-    lightsColors[currentColor++] = color.a;
+    for (GLuint texture : { lightMapColor, lightMapWeight })
+    {
+      glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
 
-    currentLight += 1;
+    glCreateFramebuffers(1, &lightMapFrameBuffer);
+    glNamedFramebufferTexture(lightMapFrameBuffer, GL_COLOR_ATTACHMENT0, lightMapColor, 0);
+    glNamedFramebufferTexture(lightMapFrameBuffer, GL_COLOR_ATTACHMENT1, lightMapWeight, 0);
+
+    const GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glNamedFramebufferDrawBuffers(lightMapFrameBuffer, 2, attachments);
   }
 
-  void LightRenderer::addLight(Entity entity)
+  void LightRenderer::addLight(const Vector& position, float radius, const Color& color, const float* shadowMap)
   {
-    FLECTRON_ASSERT(currentLight < FLECTRON_NUM_LIGHTS, "Too many lights");
+    if (currentLight == (int)lights.size())
+    {
+      if (currentLight >= maxLights)
+      {
+        if (droppedLights++ == 0)
+          FLECTRON_LOG_WARN("Only {} lights can be rendered, the rest of this frame's lights are dropped", maxLights);
+        return;
+      }
+      growLights();
+    }
 
+    if (shadowMap != nullptr)
+    {
+      float* row = &shadowMaps[(size_t)currentLight * ShadowMap::Resolution];
+      if (std::memcmp(row, shadowMap, ShadowMap::Resolution * sizeof(float)) != 0)
+      {
+        std::memcpy(row, shadowMap, ShadowMap::Resolution * sizeof(float));
+        firstDirtyShadow = std::min(firstDirtyShadow, currentLight);
+        lastDirtyShadow = std::max(lastDirtyShadow, currentLight);
+      }
+    }
+
+    lights[currentLight++] = { { position.x, position.y }, radius, shadowMap != nullptr ? 1.0f : 0.0f, { color.r, color.g, color.b, color.a } };
+  }
+
+  void LightRenderer::addLight(Entity entity)
+  {
     auto& pc = entity.get<PositionComponent>();
     auto& lc = entity.get<LightComponent>();
 
-    lightsData[currentData++] = pc.position.x;
-    lightsData[currentData++] = pc.position.y;
-    lightsData[currentData++] = lc.lightRadius;
+    const float* shadowMap = nullptr;
+    if (entity.has<ShadowComponent>() && entity.get<ShadowComponent>().shadowMap.size() == (size_t)ShadowMap::Resolution)
+      shadowMap = entity.get<ShadowComponent>().shadowMap.data();
 
-    lightsColors[currentColor++] = lc.lightColor.r;
-    lightsColors[currentColor++] = lc.lightColor.g;
-    lightsColors[currentColor++] = lc.lightColor.b;
-    lightsColors[currentColor++] = lc.lightColor.a;
-    
-    currentLight += 1;
+    addLight(pc.position, lc.lightRadius, lc.lightColor, shadowMap);
   }
 
 }
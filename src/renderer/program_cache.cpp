@@ -0,0 +1,93 @@
+#include <flectron/renderer/program_cache.hpp>
+#include <flectron/assert/log.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+
+namespace flectron
+{
+
+  static const uint32_t ProgramCacheMagic = 0x46505243; // FPRC
+
+  struct ProgramCacheHeader
+  {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+    uint64_t size;
+  };
+
+  uint64_t ProgramCache::hash(std::string_view data, uint64_t seed)
+  {
+    uint64_t hash = seed;
+    for (char c : data)
+      hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+    return hash;
+  }
+
+  uint64_t ProgramCache::key(const std::string& driver, std::initializer_list<std::string_view> sources)
+  {
+    uint64_t key = hash(driver);
+    for (const auto& source : sources)
+    {
+      // The length keeps the boundaries between stages from shifting
+      const uint64_t size = source.size();
+      key = hash(std::string_view((const char*)&size, sizeof(size)), key);
+      key = hash(source, key);
+    }
+    return key;
+  }
+
+  FileProgramCache::FileProgramCache(const std::string& directory)
+    : directory(directory)
+  {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+      FLECTRON_LOG_WARN("Failed to create program cache directory {}: {}", directory, error.message());
+  }
+
+  std::string FileProgramCache::getPath(uint64_t key) const
+  {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return (std::filesystem::path(directory) / name).string();
+  }
+
+  bool FileProgramCache::load(uint64_t key, Binary& binary)
+  {
+    std::ifstream file(getPath(key), std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+      return false;
+
+    const uint64_t fileSize = (uint64_t)file.tellg();
+    ProgramCacheHeader header;
+    file.seekg(0);
+    if (fileSize < sizeof(header) || !file.read((char*)&header, sizeof(header)))
+      return false;
+
+    // Truncated or foreign files are treated as a miss and overwritten after compiling
+    if (header.magic != ProgramCacheMagic || header.key != key || header.size != fileSize - sizeof(header))
+      return false;
+
+    binary.format = (GLenum)header.format;
+    binary.data.resize((size_t)header.size);
+    return (bool)file.read(binary.data.data(), (std::streamsize)header.size);
+  }
+
+  void FileProgramCache::store(uint64_t key, const Binary& binary)
+  {
+    std::ofstream file(getPath(key), std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+      FLECTRON_LOG_WARN("Failed to write program cache file {}", getPath(key));
+      return;
+    }
+
+    const ProgramCacheHeader header = { ProgramCacheMagic, (uint32_t)binary.format, key, (uint64_t)binary.data.size() };
+    file.write((const char*)&header, sizeof(header));
+    file.write(binary.data.data(), (std::streamsize)binary.data.size());
+  }
+
+}
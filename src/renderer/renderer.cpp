@@ -5,6 +5,11 @@
 #include <sstream>
 #include <iostream>
 #include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+#include <mutex>
+#include <atomic>
 
 #include <flectron/renderer/color.hpp>
 #include <flectron/physics/vector.hpp>
@@ -17,56 +22,130 @@
 #include <stb_image.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <flectron/assets/text.hpp>
-
-FLECTRON_EMBED(FLECTRON_SHADER_TEXTURE_VERT);
-FLECTRON_EMBED(FLECTRON_SHADER_TEXTURE_FRAG);
-FLECTRON_EMBED(FLECTRON_SHADER_CIRCLE_VERT);
-FLECTRON_EMBED(FLECTRON_SHADER_CIRCLE_FRAG);
-FLECTRON_EMBED(FLECTRON_SHADER_LINE_VERT);
-FLECTRON_EMBED(FLECTRON_SHADER_LINE_GEOM);
-FLECTRON_EMBED(FLECTRON_SHADER_LINE_FRAG);
+#include <flectron/assert/assert.hpp>
 
 namespace flectron
 {
 
-  static const std::size_t MaxTriangleCount = 10000;
-  static const std::size_t MaxVertexCount = MaxTriangleCount * 3;
-  static const std::size_t MaxIndexCount = MaxTriangleCount * 3;
+  static const std::size_t MaxVertexCount = RendererBackend::MaxVertexCount;
+  static const std::size_t MaxIndexCount = RendererBackend::MaxIndexCount;
   static size_t MaxTextureSlots;
 
-  struct TextureVertex
+  // Direct-mapped texture to slot table, entries written in earlier batches are told apart by their generation
+  static const std::size_t TextureSlotTableSize = 1024;
+
+  struct TextureSlotEntry
+  {
+    uint32_t textureID = 0;
+    uint32_t generation = 0;
+    uint32_t slot = 0;
+  };
+
+  enum class RenderCommandType : uint8_t
+  {
+    Quad, Polygon, Ellipse, Line
+  };
+
+  // Key layout from the most significant bit: layer (8), shader (4), texture (20), depth (32)
+  struct RenderCommand
+  {
+    uint64_t key;
+    uint32_t index;
+    RenderCommandType type;
+  };
+
+  struct QueuedQuad
   {
-    glm::vec2 position;
-    glm::vec4 color;
-    glm::vec2 textureCoord;
-    float textureIndex;
+    Vector corners[4];
+    glm::vec4 texturePosition;
+    Color tint;
+    uint32_t textureID;
     float tilingFactor;
   };
 
-  struct CircleVertex
+  struct QueuedPolygon
   {
-    glm::vec2 worldPosition;
-    glm::vec2 localPosition;
-    glm::vec4 color;
+    size_t firstVertex;
+    size_t vertexCount;
+    size_t firstTriangle;
+    Color color;
+  };
+
+  struct QueuedEllipse
+  {
+    Vector corners[4];
     float thickness;
     float fade;
+    Color color;
   };
 
-  struct LineVertex
+  struct QueuedPolyline
   {
-    glm::vec2 position;
-    glm::vec4 color;
+    size_t firstVertex;
+    size_t vertexCount;
     float thickness;
+    bool isClosed;
+    Color color;
+  };
+
+  struct Renderer::CommandBuffer::Data
+  {
+    uint64_t layerKey = 0;
+
+    std::vector<RenderCommand> commands;
+    std::vector<QueuedQuad> quads;
+    std::vector<QueuedPolygon> polygons;
+    std::vector<Vector> polygonVertices;
+    std::vector<size_t> polygonTriangles;
+    std::vector<QueuedEllipse> ellipses;
+    std::vector<QueuedPolyline> polylines;
+    std::vector<Vector> polylineVertices;
+
+    // The layer is kept, it is a setting rather than a recorded shape
+    void clear()
+    {
+      commands.clear();
+      quads.clear();
+      polygons.clear();
+      polygonVertices.clear();
+      polygonTriangles.clear();
+      ellipses.clear();
+      polylines.clear();
+      polylineVertices.clear();
+    }
+  };
+
+  // Sharper corners are cut at this many thicknesses away from the joint
+  static const float MiterLimit = 4.0f;
+
+  // Strings this short are laid out on every call, longer ones are laid out once and cached
+  static const std::size_t MaxUncachedTextLength = 16;
+  static const std::size_t MaxCachedTextRuns = 256;
+
+  // Glyph quad relative to where the text starts
+  struct TextGlyph
+  {
+    glm::vec2 topLeft;
+    glm::vec2 bottomRight;
+    glm::vec4 texturePosition;
+  };
+
+  struct TextRun
+  {
+    std::weak_ptr<FontAtlas> atlas;
+    std::string text;
+    float scale;
+    std::vector<TextGlyph> glyphs;
   };
 
   struct RendererData
   {
-    GLuint frameBuffer = 0;
+    Scope<RendererBackend> backend = nullptr;
+    Scope<RendererBackend> capturedBackend = nullptr;
 
     // Texture rendering
-    GLuint textureVertexArray = 0;
-    GLuint textureVertexBuffer = 0;
-    GLuint textureIndexBuffer = 0;
+    TextureVertex* textureStaging = nullptr;
+    uint32_t* textureIndicesStaging = nullptr;
 
     TextureVertex* textureBuffer = nullptr;
     TextureVertex* textureBufferPointer = nullptr;
@@ -79,18 +158,46 @@ namespace flectron
 
     GLuint whiteTexture = 0;
 
-    uint32_t* textureSlots = nullptr;
+    std::vector<uint32_t> textureSlots;
     uint32_t textureSlotIndex = 1;
 
-    Text textureShaderVertex;
-    Text textureShaderFragment;
-    Shader::Pointer textureShader = nullptr;
+    Ref<TextureArray> textureArray = nullptr;
+    // Recording threads read the texture array without a lock, so it cannot change while they run
+    std::atomic<int> recordingThreads{ 0 };
+
+    std::array<TextureSlotEntry, TextureSlotTableSize> textureSlotTable;
+    uint32_t textureSlotGeneration = 0;
+
+    // Instanced rendering
+    bool isInstancingRequested = FLECTRON_INSTANCED_RENDERING;
+    bool isInstancing = false;
+
+    QuadInstance* quadInstances = nullptr;
+    uint32_t quadInstanceCount = 0;
+
+    // Where the texture batch switched between indexed shapes and quad instances,
+    // the counts are what the closed segments already cover
+    std::vector<TextureSegment> textureSegments;
+    uint32_t segmentedIndexCount = 0;
+    uint32_t segmentedInstanceCount = 0;
+
+    CircleInstance* circleInstances = nullptr;
+    uint32_t circleInstanceCount = 0;
+
+    // Sorted rendering
+    bool isSorting = FLECTRON_SORTED_RENDERING;
+    bool isReplaying = false;
+
+    Renderer::CommandBuffer::Data queue;
+    std::vector<RenderCommand> sortedCommands;
+
+    // Text rendering, runs are keyed by the hash of their atlas, text and scale,
+    // the lock is there for text drawn while recording on other threads
+    std::unordered_map<size_t, TextRun> textRuns;
+    std::mutex textRunMutex;
 
     // Circle rendering
-    GLuint circleVertexArray = 0;
-    GLuint circleVertexBuffer = 0;
-    GLuint circleIndexBuffer = 0;
-    
+    CircleVertex* circleStaging = nullptr;
     CircleVertex* circleBuffer = nullptr;
     CircleVertex* circleBufferPointer = nullptr;
 
@@ -98,283 +205,267 @@ namespace flectron
 
     glm::vec2 circleVertexPositions[4];
 
-    Text circleShaderVertex;
-    Text circleShaderFragment;
-    Shader::Pointer circleShader = nullptr;
-
     // Line rendering
-    GLuint lineVertexArray = 0;
-    GLuint lineVertexBuffer = 0;
-
+    LineVertex* lineStaging = nullptr;
     LineVertex* lineBuffer = nullptr;
     LineVertex* lineBufferPointer = nullptr;
+    LineVertex lastLineVertex;
 
     uint32_t lineIndexCount = 0;
-    
-    Text lineShaderVertex;
-    Text lineShaderFragment;
-    Text lineShaderGeometry;
-    Shader::Pointer lineShader = nullptr;
 
     // Statistics
     Renderer::Statistics statistics;
-
-    // Camera
-    GLuint cameraUniformBuffer = 0;
+    bool isGpuTiming = FLECTRON_GPU_TIMING;
+    bool isFrameTimerRunning = false;
   };
 
   static RendererData rendererData;
 
-  void Renderer::initTextureRendering()
+  static float elapsedMilliseconds(std::chrono::steady_clock::time_point start)
   {
-    rendererData.textureBuffer = new TextureVertex[MaxVertexCount];
-
-    glCreateVertexArrays(1, &rendererData.textureVertexArray);
-    glBindVertexArray(rendererData.textureVertexArray);
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
 
-    glCreateBuffers(1, &rendererData.textureVertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, rendererData.textureVertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(TextureVertex), nullptr, GL_DYNAMIC_DRAW);
+  // Returns the slot of the texture in the current batch or 0 when it is not bound yet
+  static uint32_t findTextureSlot(uint32_t textureID)
+  {
+    const auto& entry = rendererData.textureSlotTable[textureID & (TextureSlotTableSize - 1)];
+    if (entry.generation != rendererData.textureSlotGeneration)
+      return 0;
 
-    glEnableVertexArrayAttrib(rendererData.textureVertexArray, 0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, position));
+    if (entry.textureID == textureID)
+      return entry.slot;
 
-    glEnableVertexArrayAttrib(rendererData.textureVertexArray, 1);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, color));
+    // Another texture of this batch took the entry, so only a scan can tell
+    for (uint32_t i = 1; i < rendererData.textureSlotIndex; i++)
+      if (rendererData.textureSlots[i] == textureID)
+        return i;
 
-    glEnableVertexArrayAttrib(rendererData.textureVertexArray, 2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, textureCoord));
+    return 0;
+  }
 
-    glEnableVertexArrayAttrib(rendererData.textureVertexArray, 3);
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, textureIndex));
+  static uint32_t bindTextureSlot(uint32_t textureID)
+  {
+    const uint32_t slot = rendererData.textureSlotIndex++;
+    rendererData.textureSlots[slot] = textureID;
+    rendererData.textureSlotTable[textureID & (TextureSlotTableSize - 1)] = { textureID, rendererData.textureSlotGeneration, slot };
+    return slot;
+  }
 
-    glEnableVertexArrayAttrib(rendererData.textureVertexArray, 4);
-    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(TextureVertex), (const void*)offsetof(TextureVertex, tilingFactor));
+  // Set on threads that record into a command buffer, everything they draw goes there
+  static thread_local Renderer::CommandBuffer::Data* recordingQueue = nullptr;
 
-    rendererData.textureIndices = new uint32_t[MaxIndexCount];
+  static Renderer::CommandBuffer::Data& currentQueue()
+  {
+    return recordingQueue != nullptr ? *recordingQueue : rendererData.queue;
+  }
 
-    glGenBuffers(1, &rendererData.textureIndexBuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rendererData.textureIndexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, MaxIndexCount * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+  static bool isQueueing()
+  {
+    return recordingQueue != nullptr || (rendererData.isSorting && !rendererData.isReplaying);
+  }
 
-    GLint tempMaxTextureSlots;
-    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &tempMaxTextureSlots);
-    MaxTextureSlots = (size_t)tempMaxTextureSlots;
-    rendererData.textureSlots = new uint32_t[MaxTextureSlots];
+  static void enqueue(Renderer::CommandBuffer::Data& queue, RenderCommandType type, uint64_t shader, uint32_t texture, size_t index)
+  {
+    const uint64_t key = queue.layerKey | (shader << 52) | ((uint64_t)(texture & 0xFFFFF) << 32);
+    queue.commands.push_back({ key, (uint32_t)index, type });
+  }
 
-    glCreateTextures(GL_TEXTURE_2D, 1, &rendererData.whiteTexture);
-    glBindTexture(GL_TEXTURE_2D, rendererData.whiteTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    uint32_t white = 0xffffffff;
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+  static void clearQueue()
+  {
+    rendererData.queue.clear();
+  }
 
-    rendererData.textureSlots[0] = rendererData.whiteTexture;
-    for (size_t i = 1; i < MaxTextureSlots; i++)
-      rendererData.textureSlots[i] = 0;
+  // Stable LSD radix sort, bytes that are equal across all keys are skipped
+  static void sortCommands(std::vector<RenderCommand>& commands, std::vector<RenderCommand>& scratch)
+  {
+    if (commands.empty())
+      return;
 
-    int* samplers = new int[MaxTextureSlots];
-    for (size_t i = 0; i < MaxTextureSlots; i++)
-      samplers[i] = (int)i;
+    scratch.resize(commands.size());
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+      size_t counts[256] = {};
+      for (const auto& command : commands)
+        counts[(command.key >> shift) & 0xFF]++;
 
-    rendererData.textureShaderVertex = Text::fromEmbed(FLECTRON_SHADER_TEXTURE_VERT());
-    rendererData.textureShaderVertex.load();
+      if (counts[(commands.front().key >> shift) & 0xFF] == commands.size())
+        continue;
 
-    rendererData.textureShaderFragment = Text::fromEmbed(FLECTRON_SHADER_TEXTURE_FRAG());
-    rendererData.textureShaderFragment.load();
+      size_t offset = 0;
+      for (auto& count : counts)
+      {
+        const size_t current = count;
+        count = offset;
+        offset += current;
+      }
 
-    // rendererData.textureShader = Shader::create({
-    //   .vertex = rendererData.textureShaderVertex,
-    //   .fragment = rendererData.textureShaderFragment
-    // });
-    rendererData.textureShader = Shader::create({
-      rendererData.textureShaderVertex,
-      nullptr,
-      rendererData.textureShaderFragment,
-      nullptr
-    });
-    rendererData.textureShader->bind();
-    rendererData.textureShader->setUniform1iv("uTextures", samplers, tempMaxTextureSlots);
-    rendererData.textureShader->setUniform1f("uZIndex", 0.3f);
-    
-    delete[] samplers;
+      for (const auto& command : commands)
+        scratch[counts[(command.key >> shift) & 0xFF]++] = command;
+      commands.swap(scratch);
+    }
   }
 
-  void Renderer::initCircleRendering()
+  void Renderer::init(int width, int height, GLuint& buffer)
   {
-    rendererData.circleBuffer = new CircleVertex[MaxVertexCount];
+    init(createScope<OpenGLRendererBackend>(width, height, buffer));
+  }
 
-    glCreateVertexArrays(1, &rendererData.circleVertexArray);
-    glBindVertexArray(rendererData.circleVertexArray);
+  void Renderer::init(Scope<RendererBackend> backend)
+  {
+    FLECTRON_LOG_TRACE("Initializing renderer");
+    rendererData.textureStaging = new TextureVertex[MaxVertexCount];
+    rendererData.textureIndicesStaging = new uint32_t[MaxIndexCount];
+    rendererData.circleStaging = new CircleVertex[MaxVertexCount];
+    rendererData.lineStaging = new LineVertex[MaxVertexCount];
+    rendererData.quadInstances = new QuadInstance[RendererBackend::MaxInstanceCount];
+    rendererData.circleInstances = new CircleInstance[RendererBackend::MaxInstanceCount];
 
-    glCreateBuffers(1, &rendererData.circleVertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, rendererData.circleVertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(CircleVertex), nullptr, GL_DYNAMIC_DRAW);
+    rendererData.circleVertexPositions[0] = glm::vec2(-0.5f, -0.5f) * 2.0f;
+    rendererData.circleVertexPositions[1] = glm::vec2( 0.5f, -0.5f) * 2.0f;
+    rendererData.circleVertexPositions[2] = glm::vec2( 0.5f,  0.5f) * 2.0f;
+    rendererData.circleVertexPositions[3] = glm::vec2(-0.5f,  0.5f) * 2.0f;
 
-    glEnableVertexArrayAttrib(rendererData.circleVertexArray, 0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, worldPosition));
+    setBackend(std::move(backend));
+    rendererData.statistics.reset();
+  }
 
-    glEnableVertexArrayAttrib(rendererData.circleVertexArray, 1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, localPosition));
+  void Renderer::shutdown()
+  {
+    FLECTRON_LOG_TRACE("Shutting down renderer");
 
-    glEnableVertexArrayAttrib(rendererData.circleVertexArray, 2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, color));
+    rendererData.backend.reset();
+    rendererData.textureArray.reset();
+    rendererData.textRuns.clear();
 
-    glEnableVertexArrayAttrib(rendererData.circleVertexArray, 3);
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, fade));
+    delete[] rendererData.textureStaging;
+    delete[] rendererData.textureIndicesStaging;
+    rendererData.textureSlots.clear();
 
-    glEnableVertexArrayAttrib(rendererData.circleVertexArray, 4);
-    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(CircleVertex), (const void*)offsetof(CircleVertex, thickness));
+    delete[] rendererData.circleStaging;
 
-    uint32_t* indices = new uint32_t[MaxIndexCount];
-    uint32_t offset = 0;
+    delete[] rendererData.lineStaging;
 
-    for (uint32_t i = 0; i < MaxIndexCount; i += 6)
-    {
-      indices[i + 0] = offset + 0;
-      indices[i + 1] = offset + 1;
-      indices[i + 2] = offset + 2;
+    delete[] rendererData.quadInstances;
+    delete[] rendererData.circleInstances;
+  }
 
-      indices[i + 3] = offset + 2;
-      indices[i + 4] = offset + 3;
-      indices[i + 5] = offset + 0;
+  Scope<RendererBackend> Renderer::setBackend(Scope<RendererBackend> backend)
+  {
+    FLECTRON_ASSERT(backend != nullptr, "Renderer backend cannot be null");
+    // Whatever was batched so far is drawn by the backend it was batched for
+    if (rendererData.backend != nullptr)
+      endBatch();
 
-      offset += 4;
+    if (rendererData.isFrameTimerRunning)
+    {
+      rendererData.backend->endFrameTimer();
+      rendererData.isFrameTimerRunning = false;
     }
+    Scope<RendererBackend> previous = std::move(rendererData.backend);
+    rendererData.backend = std::move(backend);
 
-    glCreateBuffers(1, &rendererData.circleIndexBuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rendererData.circleIndexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, MaxIndexCount * sizeof(uint32_t), indices, GL_STATIC_DRAW);
-
-    delete[] indices;
-
-    rendererData.circleVertexPositions[0] = glm::vec2(-0.5f, -0.5f) * 2.0f;
-		rendererData.circleVertexPositions[1] = glm::vec2( 0.5f, -0.5f) * 2.0f;
-		rendererData.circleVertexPositions[2] = glm::vec2( 0.5f,  0.5f) * 2.0f;
-		rendererData.circleVertexPositions[3] = glm::vec2(-0.5f,  0.5f) * 2.0f;
-
-    rendererData.circleShaderVertex = Text::fromEmbed(FLECTRON_SHADER_CIRCLE_VERT());
-    rendererData.circleShaderVertex.load();
+    MaxTextureSlots = rendererData.backend->getMaxTextureSlots();
+    rendererData.whiteTexture = rendererData.backend->getWhiteTexture();
+    rendererData.textureSlots.assign(MaxTextureSlots, 0);
+    rendererData.textureSlots[0] = rendererData.whiteTexture;
+    rendererData.isInstancing = rendererData.isInstancingRequested && rendererData.backend->supportsInstancing();
+    rendererData.backend->setTextureArray(rendererData.textureArray ? rendererData.textureArray->getGPU() : 0u);
 
-    rendererData.circleShaderFragment = Text::fromEmbed(FLECTRON_SHADER_CIRCLE_FRAG());
-    rendererData.circleShaderFragment.load();
-    
-    rendererData.circleShader = Shader::create({
-      rendererData.circleShaderVertex,
-      nullptr,
-      rendererData.circleShaderFragment,
-      nullptr
-    });
-    rendererData.circleShader->bind();
-    rendererData.circleShader->setUniform1f("uZIndex", 0.2f);
+    beginBatch();
+    return previous;
   }
 
-  void Renderer::initLineRendering()
+  void Renderer::beginFrame()
   {
-    rendererData.lineBuffer = new LineVertex[MaxVertexCount];
-
-    glCreateVertexArrays(1, &rendererData.lineVertexArray);
-    glBindVertexArray(rendererData.lineVertexArray);
-
-    glCreateBuffers(1, &rendererData.lineVertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, rendererData.lineVertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, MaxVertexCount * sizeof(LineVertex), nullptr, GL_DYNAMIC_DRAW);
-
-    glEnableVertexArrayAttrib(rendererData.lineVertexArray, 0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (const void*)offsetof(LineVertex, position));
-
-    glEnableVertexArrayAttrib(rendererData.lineVertexArray, 1);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (const void*)offsetof(LineVertex, color));
-
-    glEnableVertexArrayAttrib(rendererData.lineVertexArray, 2);
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (const void*)offsetof(LineVertex, thickness));
-
-    rendererData.lineShaderVertex = Text::fromEmbed(FLECTRON_SHADER_LINE_VERT());
-    rendererData.lineShaderVertex.load();
+    rendererData.statistics.reset();
+    if (rendererData.isGpuTiming && !rendererData.isFrameTimerRunning)
+    {
+      rendererData.backend->beginFrameTimer();
+      rendererData.isFrameTimerRunning = true;
+    }
+  }
 
-    rendererData.lineShaderFragment = Text::fromEmbed(FLECTRON_SHADER_LINE_FRAG());
-    rendererData.lineShaderFragment.load();
+  void Renderer::endFrame()
+  {
+    if (rendererData.isFrameTimerRunning)
+    {
+      rendererData.backend->endFrameTimer();
+      rendererData.isFrameTimerRunning = false;
+    }
 
-    rendererData.lineShaderGeometry = Text::fromEmbed(FLECTRON_SHADER_LINE_GEOM());
-    rendererData.lineShaderGeometry.load();
+    float gpuMilliseconds = 0.0f;
+    if (rendererData.backend->getFrameTime(gpuMilliseconds))
+    {
+      rendererData.statistics.gpuMilliseconds = gpuMilliseconds;
+      rendererData.statistics.gpuHistory.add(gpuMilliseconds);
+    }
 
-    rendererData.lineShader = Shader::create({
-      rendererData.lineShaderVertex,
-      rendererData.lineShaderGeometry,
-      rendererData.lineShaderFragment,
-      nullptr
-    });
-    rendererData.lineShader->bind();
-    rendererData.lineShader->setUniform1f("uZIndex", 0.1f);
+    rendererData.statistics.endFrame();
   }
 
-  void Renderer::initCamera()
+  void Renderer::setGpuTiming(bool enabled)
   {
-    glGenBuffers(1, &rendererData.cameraUniformBuffer);
-    glBindBuffer(GL_UNIFORM_BUFFER, rendererData.cameraUniformBuffer);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    rendererData.isGpuTiming = enabled;
   }
 
-  void Renderer::init(int width, int height, GLuint& buffer)
+  bool Renderer::isGpuTiming()
   {
-    FLECTRON_LOG_TRACE("Initializing renderer");
-    initTextureRendering();
-    initCircleRendering();
-    initLineRendering();
-    rendererData.statistics.reset();
-    rendererData.frameBuffer = createFrameBuffer(width, height, buffer);
-    initCamera();
+    return rendererData.isGpuTiming;
   }
 
-  void Renderer::shutdown()
+  void Renderer::setInstancing(bool enabled)
   {
-    FLECTRON_LOG_TRACE("Shutting down renderer");
-
-    glDeleteVertexArrays(1, &rendererData.textureVertexArray);
-    glDeleteBuffers(1, &rendererData.textureVertexBuffer);
-    glDeleteBuffers(1, &rendererData.textureIndexBuffer);
-    glDeleteTextures(1, &rendererData.whiteTexture);
-
-    glDeleteVertexArrays(1, &rendererData.circleVertexArray);
-    glDeleteBuffers(1, &rendererData.circleVertexBuffer);
-    glDeleteBuffers(1, &rendererData.circleIndexBuffer);
-
-    glDeleteVertexArrays(1, &rendererData.lineVertexArray);
-    glDeleteBuffers(1, &rendererData.lineVertexBuffer);
-
-    if (rendererData.frameBuffer != 0)
-      glDeleteFramebuffers(1, &rendererData.frameBuffer);
+    endBatch();
+    rendererData.isInstancingRequested = enabled;
+    rendererData.isInstancing = enabled && rendererData.backend->supportsInstancing();
+    beginBatch();
+  }
 
-    glDeleteBuffers(1, &rendererData.cameraUniformBuffer);
+  bool Renderer::isInstancing()
+  {
+    return rendererData.isInstancing;
+  }
 
-    delete[] rendererData.textureBuffer;
-    delete[] rendererData.textureIndices;
-    delete[] rendererData.textureSlots;
+  void Renderer::setSorting(bool enabled)
+  {
+    endBatch();
+    rendererData.isSorting = enabled;
+    beginBatch();
+  }
 
-    delete[] rendererData.circleBuffer;
+  bool Renderer::isSorting()
+  {
+    return rendererData.isSorting;
+  }
 
-    delete[] rendererData.lineBuffer;
+  void Renderer::setLayer(uint8_t layer, uint32_t depth)
+  {
+    currentQueue().layerKey = ((uint64_t)layer << 56) | depth;
+  }
 
-    rendererData.textureShaderVertex.unload();
-    rendererData.textureShaderFragment.unload();
-    
-    rendererData.circleShaderVertex.unload();
-    rendererData.circleShaderFragment.unload();
+  void Renderer::setTextureArray(const Ref<TextureArray>& textureArray)
+  {
+    FLECTRON_ASSERT(rendererData.recordingThreads == 0, "The texture array cannot change while command buffers are recorded");
+    endBatch();
+    rendererData.textureArray = textureArray;
+    rendererData.backend->setTextureArray(textureArray ? textureArray->getGPU() : 0u);
+    beginBatch();
+  }
 
-    rendererData.lineShaderVertex.unload();
-    rendererData.lineShaderFragment.unload();
+  RendererBackend& Renderer::backend()
+  {
+    return *rendererData.backend;
   }
 
   void Renderer::setViewProjectionMatrix(const Camera& camera)
   {
-    glBindBuffer(GL_UNIFORM_BUFFER, rendererData.cameraUniformBuffer);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), glm::value_ptr(camera.getViewProjectionMatrix()), GL_DYNAMIC_DRAW);
+    rendererData.backend->setViewProjectionMatrix(camera.getViewProjectionMatrix());
   }
 
   void Renderer::beginBatch()
   {
+    clearQueue();
     beginTextureBatch();
     beginCircleBatch();
     beginLineBatch();
@@ -382,100 +473,367 @@ namespace flectron
 
   void Renderer::endBatch()
   {
-    endTextureBatch();
-    endCircleBatch();
-    endLineBatch();
+    flushQueue();
+    endTextureBatch(FlushReason::EndBatch);
+    endCircleBatch(FlushReason::EndBatch);
+    endLineBatch(FlushReason::EndBatch);
+  }
+
+  // The backend is swapped for a recording one while capturing, instancing is turned off
+  // so the static batch is made of plain vertices only
+  void Renderer::beginStaticBatch()
+  {
+    FLECTRON_ASSERT(rendererData.capturedBackend == nullptr, "Static batch was already begun");
+    endBatch();
+
+    const RendererBackend& backend = *rendererData.backend;
+    Scope<RendererBackend> recording = createScope<RecordingRendererBackend>(backend.getMaxTextureSlots(), backend.getWhiteTexture());
+    rendererData.capturedBackend = std::move(rendererData.backend);
+    rendererData.backend = std::move(recording);
+    rendererData.isInstancing = false;
+
+    beginBatch();
+  }
+
+  uint32_t Renderer::endStaticBatch()
+  {
+    FLECTRON_ASSERT(rendererData.capturedBackend != nullptr, "Static batch was not begun");
+    endBatch();
+
+    Scope<RendererBackend> recording = std::move(rendererData.backend);
+    rendererData.backend = std::move(rendererData.capturedBackend);
+    rendererData.isInstancing = rendererData.isInstancingRequested && rendererData.backend->supportsInstancing();
+
+    beginBatch();
+    return rendererData.backend->createStaticBatch(static_cast<RecordingRendererBackend&>(*recording));
+  }
+
+  // Pending batches are flushed first so the static one keeps its place in the draw order
+  void Renderer::drawStaticBatch(uint32_t batch)
+  {
+    endBatch();
+    const auto start = std::chrono::steady_clock::now();
+    rendererData.backend->drawStaticBatch(batch);
+    rendererData.statistics.flushCounts[(size_t)Statistics::BatchType::Static]++;
+    rendererData.statistics.submitMilliseconds += elapsedMilliseconds(start);
+    beginBatch();
   }
 
+  void Renderer::destroyStaticBatch(uint32_t batch)
+  {
+    if (rendererData.backend != nullptr)
+      rendererData.backend->destroyStaticBatch(batch);
+  }
+
+  // Batches are written straight into the memory the backend maps, or into the staging arrays otherwise
   void Renderer::beginTextureBatch()
   {
+    TextureVertex* mappedVertices = rendererData.backend->mapTextureVertices();
+    uint32_t* mappedIndices = rendererData.backend->mapTextureIndices();
+    rendererData.textureBuffer = mappedVertices ? mappedVertices : rendererData.textureStaging;
+    rendererData.textureIndices = mappedIndices ? mappedIndices : rendererData.textureIndicesStaging;
+
     rendererData.textureBufferPointer = rendererData.textureBuffer;
     rendererData.textureIndicesPointer = rendererData.textureIndices;
     rendererData.textureIndexCount = 0;
     rendererData.textureOffset = 0;
     rendererData.textureSlotIndex = 1;
+    rendererData.quadInstanceCount = 0;
+    rendererData.textureSegments.clear();
+    rendererData.segmentedIndexCount = 0;
+    rendererData.segmentedInstanceCount = 0;
+
+    if (++rendererData.textureSlotGeneration == 0)
+    {
+      rendererData.textureSlotTable.fill({});
+      rendererData.textureSlotGeneration = 1;
+    }
+  }
+
+  // Closes the run of indexed shapes or quad instances written since the last switch
+  static void closeTextureSegment()
+  {
+    if (rendererData.textureIndexCount != rendererData.segmentedIndexCount)
+    {
+      rendererData.textureSegments.push_back({ false, rendererData.segmentedIndexCount, rendererData.textureIndexCount - rendererData.segmentedIndexCount });
+      rendererData.segmentedIndexCount = rendererData.textureIndexCount;
+    }
+    if (rendererData.quadInstanceCount != rendererData.segmentedInstanceCount)
+    {
+      rendererData.textureSegments.push_back({ true, rendererData.segmentedInstanceCount, rendererData.quadInstanceCount - rendererData.segmentedInstanceCount });
+      rendererData.segmentedInstanceCount = rendererData.quadInstanceCount;
+    }
   }
 
-  void Renderer::endTextureBatch()
+  // A batch that switched between indexed shapes and quad instances is drawn in segments,
+  // so neither kind ends up on top of shapes submitted after it
+  void Renderer::endTextureBatch(FlushReason reason)
   {
-    if (rendererData.textureIndexCount == 0)
+    if (!rendererData.textureSegments.empty())
+    {
+      closeTextureSegment();
+
+      const auto start = std::chrono::steady_clock::now();
+      const size_t vertexCount = rendererData.textureBufferPointer - rendererData.textureBuffer;
+      rendererData.backend->drawTextureSegments(
+        rendererData.textureBuffer, vertexCount,
+        rendererData.textureIndices, rendererData.textureIndexCount,
+        rendererData.quadInstances, rendererData.quadInstanceCount,
+        rendererData.textureSegments.data(), rendererData.textureSegments.size(),
+        rendererData.textureSlots.data(), rendererData.textureSlotIndex);
+      rendererData.statistics.recordFlush(Statistics::BatchType::Texture, reason, vertexCount, rendererData.textureIndexCount, rendererData.quadInstanceCount,
+        vertexCount * sizeof(TextureVertex) + rendererData.textureIndexCount * sizeof(uint32_t) + rendererData.quadInstanceCount * sizeof(QuadInstance), start);
       return;
+    }
 
-    rendererData.textureShader->bind();
-    rendererData.textureShader->setUniformBlock("CameraBlock", rendererData.cameraUniformBuffer);
+    if (rendererData.textureIndexCount != 0)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      const size_t vertexCount = rendererData.textureBufferPointer - rendererData.textureBuffer;
+      rendererData.backend->drawTextures(
+        rendererData.textureBuffer, vertexCount,
+        rendererData.textureIndices, rendererData.textureIndexCount,
+        rendererData.textureSlots.data(), rendererData.textureSlotIndex);
+      rendererData.statistics.recordFlush(Statistics::BatchType::Texture, reason, vertexCount, rendererData.textureIndexCount, 0,
+        vertexCount * sizeof(TextureVertex) + rendererData.textureIndexCount * sizeof(uint32_t), start);
+    }
 
-    glBindVertexArray(rendererData.textureVertexArray);
+    if (rendererData.quadInstanceCount != 0)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      rendererData.backend->drawQuadInstances(
+        rendererData.quadInstances, rendererData.quadInstanceCount,
+        rendererData.textureSlots.data(), rendererData.textureSlotIndex);
+      rendererData.statistics.recordFlush(Statistics::BatchType::QuadInstances, reason, 0, 0, rendererData.quadInstanceCount,
+        rendererData.quadInstanceCount * sizeof(QuadInstance), start);
+    }
+  }
 
-    GLsizeiptr textureSize = (uint8_t*)rendererData.textureBufferPointer - (uint8_t*)rendererData.textureBuffer;
-    glBindBuffer(GL_ARRAY_BUFFER, rendererData.textureVertexBuffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, textureSize, rendererData.textureBuffer);
+  void Renderer::beginCircleBatch()
+  {
+    CircleVertex* mapped = rendererData.backend->mapCircleVertices();
+    rendererData.circleBuffer = mapped ? mapped : rendererData.circleStaging;
+    rendererData.circleBufferPointer = rendererData.circleBuffer;
+    rendererData.circleIndexCount = 0;
+    rendererData.circleInstanceCount = 0;
+  }
 
-    GLsizeiptr indexSize = (uint8_t*)rendererData.textureIndicesPointer - (uint8_t*)rendererData.textureIndices;
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rendererData.textureIndexBuffer);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexSize, rendererData.textureIndices);
+  void Renderer::endCircleBatch(FlushReason reason)
+  {
+    if (rendererData.circleIndexCount != 0)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      const size_t vertexCount = rendererData.circleBufferPointer - rendererData.circleBuffer;
+      rendererData.backend->drawCircles(rendererData.circleBuffer, vertexCount);
+      rendererData.statistics.recordFlush(Statistics::BatchType::Circle, reason, vertexCount, rendererData.circleIndexCount, 0,
+        vertexCount * sizeof(CircleVertex), start);
+    }
 
-    for (uint32_t i = 0; i < rendererData.textureSlotIndex; i++)
-      glBindTextureUnit(i, rendererData.textureSlots[i]);
+    if (rendererData.circleInstanceCount != 0)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      rendererData.backend->drawCircleInstances(rendererData.circleInstances, rendererData.circleInstanceCount);
+      rendererData.statistics.recordFlush(Statistics::BatchType::CircleInstances, reason, 0, 0, rendererData.circleInstanceCount,
+        rendererData.circleInstanceCount * sizeof(CircleInstance), start);
+    }
+  }
 
-    glDrawElements(GL_TRIANGLES, rendererData.textureIndexCount, GL_UNSIGNED_INT, nullptr);
+  void Renderer::beginLineBatch()
+  {
+    LineVertex* mapped = rendererData.backend->mapLineVertices();
+    rendererData.lineBuffer = mapped ? mapped : rendererData.lineStaging;
+    rendererData.lineBufferPointer = rendererData.lineBuffer;
+    rendererData.lineIndexCount = 0;
   }
 
-  void Renderer::beginCircleBatch()
+  void Renderer::endLineBatch(FlushReason reason)
   {
-    rendererData.circleBufferPointer = rendererData.circleBuffer;
-    rendererData.circleIndexCount = 0;
+    if (rendererData.lineIndexCount == 0)
+      return;
+
+    const auto start = std::chrono::steady_clock::now();
+    rendererData.backend->drawLines(rendererData.lineBuffer, rendererData.lineIndexCount);
+    rendererData.statistics.recordFlush(Statistics::BatchType::Line, reason, rendererData.lineIndexCount, 0, 0,
+      rendererData.lineIndexCount * sizeof(LineVertex), start);
   }
 
-  void Renderer::endCircleBatch()
+  // Replays the queue in key order, a layer is drawn in full before the next one begins
+  // since every batch type of a layer has to end up below the batches of higher layers
+  void Renderer::flushQueue()
   {
-    if (rendererData.circleIndexCount == 0)
+    auto& queue = rendererData.queue;
+    if (queue.commands.empty())
       return;
 
-    rendererData.circleShader->bind();
-    rendererData.circleShader->setUniformBlock("CameraBlock", rendererData.cameraUniformBuffer);
+    const auto sortStart = std::chrono::steady_clock::now();
+    sortCommands(queue.commands, rendererData.sortedCommands);
+    rendererData.statistics.sortMilliseconds += elapsedMilliseconds(sortStart);
 
-    glBindVertexArray(rendererData.circleVertexArray);
+    replay(queue, true);
+    clearQueue();
+  }
 
-    GLsizeiptr circleSize = (uint8_t*)rendererData.circleBufferPointer - (uint8_t*)rendererData.circleBuffer;
-    glBindBuffer(GL_ARRAY_BUFFER, rendererData.circleVertexBuffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, circleSize, rendererData.circleBuffer);
+  void Renderer::replay(const CommandBuffer::Data& queue, bool splitLayers)
+  {
+    if (queue.commands.empty())
+      return;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rendererData.circleIndexBuffer);
+    rendererData.isReplaying = true;
+    uint64_t layer = queue.commands.front().key >> 56;
+    for (const auto& command : queue.commands)
+    {
+      if (splitLayers && (command.key >> 56) != layer)
+      {
+        layer = command.key >> 56;
+        endTextureBatch(FlushReason::Layer);
+        endCircleBatch(FlushReason::Layer);
+        endLineBatch(FlushReason::Layer);
+        beginTextureBatch();
+        beginCircleBatch();
+        beginLineBatch();
+      }
 
-    glDrawElements(GL_TRIANGLES, rendererData.circleIndexCount, GL_UNSIGNED_INT, nullptr);
+      switch (command.type)
+      {
+      case RenderCommandType::Quad:
+      {
+        const auto& q = queue.quads[command.index];
+        quad(q.corners[0], q.corners[1], q.corners[2], q.corners[3], q.textureID, q.tilingFactor, q.texturePosition, q.tint);
+        break;
+      }
+      case RenderCommandType::Polygon:
+      {
+        const auto& p = queue.polygons[command.index];
+        polygon(&queue.polygonVertices[p.firstVertex], p.vertexCount, &queue.polygonTriangles[p.firstTriangle], p.color);
+        break;
+      }
+      case RenderCommandType::Ellipse:
+      {
+        const auto& e = queue.ellipses[command.index];
+        ellipse(e.corners[0], e.corners[1], e.corners[2], e.corners[3], e.thickness, e.fade, e.color);
+        break;
+      }
+      case RenderCommandType::Line:
+      {
+        const auto& l = queue.polylines[command.index];
+        polyline(&queue.polylineVertices[l.firstVertex], l.vertexCount, l.thickness, l.isClosed, l.color);
+        break;
+      }
+      }
+    }
+    rendererData.isReplaying = false;
   }
 
-  void Renderer::beginLineBatch()
+  Renderer::CommandBuffer::CommandBuffer()
+    : data(createScope<Data>())
+  {}
+
+  Renderer::CommandBuffer::CommandBuffer(CommandBuffer&& other) noexcept = default;
+  Renderer::CommandBuffer& Renderer::CommandBuffer::operator=(CommandBuffer&& other) noexcept = default;
+  Renderer::CommandBuffer::~CommandBuffer() = default;
+
+  size_t Renderer::CommandBuffer::size() const
   {
-    rendererData.lineBufferPointer = rendererData.lineBuffer;
-    rendererData.lineIndexCount = 0;
+    return data->commands.size();
   }
 
-  void Renderer::endLineBatch()
+  bool Renderer::CommandBuffer::empty() const
   {
-    if (rendererData.lineIndexCount == 0)
+    return data->commands.empty();
+  }
+
+  void Renderer::CommandBuffer::clear()
+  {
+    data->clear();
+  }
+
+  void Renderer::beginRecording(CommandBuffer& buffer)
+  {
+    FLECTRON_ASSERT(recordingQueue == nullptr, "This thread is already recording");
+    recordingQueue = buffer.data.get();
+    rendererData.recordingThreads++;
+  }
+
+  void Renderer::endRecording()
+  {
+    FLECTRON_ASSERT(recordingQueue != nullptr, "This thread is not recording");
+    recordingQueue = nullptr;
+    rendererData.recordingThreads--;
+  }
+
+  bool Renderer::isRecording()
+  {
+    return recordingQueue != nullptr;
+  }
+
+  // Sorted rendering takes the recorded shapes into its queue, the recorded keys already carry
+  // their layers, otherwise they are drawn right away so they land between the shapes drawn
+  // before and after the submission
+  void Renderer::submit(CommandBuffer& buffer)
+  {
+    FLECTRON_ASSERT(recordingQueue == nullptr, "Command buffers are submitted on the render thread");
+    const auto& recorded = *buffer.data;
+
+    if (!rendererData.isSorting)
+    {
+      replay(recorded, false);
+      buffer.clear();
       return;
+    }
 
-    rendererData.lineShader->bind();
-    rendererData.lineShader->setUniformBlock("CameraBlock", rendererData.cameraUniformBuffer);
+    auto& queue = rendererData.queue;
+    for (auto command : recorded.commands)
+    {
+      switch (command.type)
+      {
+      case RenderCommandType::Quad:
+        command.index += (uint32_t)queue.quads.size();
+        break;
+      case RenderCommandType::Polygon:
+        command.index += (uint32_t)queue.polygons.size();
+        break;
+      case RenderCommandType::Ellipse:
+        command.index += (uint32_t)queue.ellipses.size();
+        break;
+      case RenderCommandType::Line:
+        command.index += (uint32_t)queue.polylines.size();
+        break;
+      }
+      queue.commands.push_back(command);
+    }
 
-    glBindVertexArray(rendererData.lineVertexArray);
+    const size_t polygonVertexOffset = queue.polygonVertices.size();
+    const size_t polygonTriangleOffset = queue.polygonTriangles.size();
+    for (auto polygon : recorded.polygons)
+    {
+      polygon.firstVertex += polygonVertexOffset;
+      polygon.firstTriangle += polygonTriangleOffset;
+      queue.polygons.push_back(polygon);
+    }
 
-    GLsizeiptr lineSize = (uint8_t*)rendererData.lineBufferPointer - (uint8_t*)rendererData.lineBuffer;
-    glBindBuffer(GL_ARRAY_BUFFER, rendererData.lineVertexBuffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, lineSize, rendererData.lineBuffer);
+    const size_t polylineVertexOffset = queue.polylineVertices.size();
+    for (auto polyline : recorded.polylines)
+    {
+      polyline.firstVertex += polylineVertexOffset;
+      queue.polylines.push_back(polyline);
+    }
 
-    glDrawArrays(GL_LINES, 0, rendererData.lineIndexCount);
+    queue.quads.insert(queue.quads.end(), recorded.quads.begin(), recorded.quads.end());
+    queue.polygonVertices.insert(queue.polygonVertices.end(), recorded.polygonVertices.begin(), recorded.polygonVertices.end());
+    queue.polygonTriangles.insert(queue.polygonTriangles.end(), recorded.polygonTriangles.begin(), recorded.polygonTriangles.end());
+    queue.ellipses.insert(queue.ellipses.end(), recorded.ellipses.begin(), recorded.ellipses.end());
+    queue.polylineVertices.insert(queue.polylineVertices.end(), recorded.polylineVertices.begin(), recorded.polylineVertices.end());
+    buffer.clear();
   }
 
   void Renderer::onscreen()
   {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    rendererData.backend->onscreen();
   }
 
   void Renderer::offscreen()
   {
-    glBindFramebuffer(GL_FRAMEBUFFER, rendererData.frameBuffer);
+    rendererData.backend->offscreen();
   }
 
   void Renderer::square(const Vector& position, float size, const Color& color)
@@ -600,37 +958,65 @@ namespace flectron
 
   void Renderer::quad(const Vector& a, const Vector& b, const Vector& c, const Vector& d, uint32_t textureID, float tilingFactor, const glm::vec4& texturePosition, const Color& tint)
   {
-    if (rendererData.textureIndexCount + 6 >= MaxIndexCount || rendererData.textureSlotIndex >= MaxTextureSlots)
+    const int arrayLayer = rendererData.textureArray ? rendererData.textureArray->getLayer(textureID) : -1;
+
+    if (isQueueing())
     {
-      endTextureBatch();
-      beginTextureBatch();
+      auto& queue = currentQueue();
+      enqueue(queue, RenderCommandType::Quad, 0, arrayLayer < 0 ? textureID : rendererData.textureArray->getGPU(), queue.quads.size());
+      queue.quads.push_back({ { a, b, c, d }, texturePosition, tint, textureID, tilingFactor });
+      return;
     }
 
-    const std::array<glm::vec2, 4> vertices = { { { a.x, a.y }, { b.x, b.y }, { c.x, c.y }, { d.x, d.y } } };
-    const std::array<glm::vec2, 4> textureCoords = { { 
-      { texturePosition.x, texturePosition.y }, 
-      { texturePosition.x + texturePosition.p, texturePosition.y }, 
-      { texturePosition.x + texturePosition.p, texturePosition.y + texturePosition.q }, 
-      { texturePosition.x, texturePosition.y + texturePosition.q } } };
     const glm::vec4 color = { tint.r, tint.g, tint.b, tint.a };
 
-    float textureIndex = 0.0f;
-    for (uint32_t i = 1; i < rendererData.textureSlotIndex; i++)
+    // Textures from the array are addressed by layer and never take a slot
+    uint32_t textureSlot = arrayLayer < 0 ? findTextureSlot(textureID) : 0;
+    const bool needsSlot = arrayLayer < 0 && textureSlot == 0;
+
+    // A texture that is already bound never forces a flush
+    const bool isBatchFull = rendererData.isInstancing
+      ? rendererData.quadInstanceCount >= RendererBackend::MaxInstanceCount
+      : rendererData.textureIndexCount + 6 >= MaxIndexCount;
+    // Instances are drawn after the indexed batch, so pending polygons are flushed first to keep the submission order
+    if (isBatchFull || (needsSlot && rendererData.textureSlotIndex >= MaxTextureSlots))
     {
-      if (rendererData.textureSlots[i] == textureID)
-      {
-        textureIndex = (float)i;
-        break;
-      }
+      endTextureBatch(isBatchFull ? FlushReason::BatchFull : FlushReason::TextureSlots);
+      beginTextureBatch();
+      textureSlot = 0;
     }
 
-    if (textureIndex == 0.0f)
+    if (arrayLayer < 0 && textureSlot == 0)
+      textureSlot = bindTextureSlot(textureID);
+
+    const float textureIndex = arrayLayer < 0 ? (float)textureSlot : -(float)(arrayLayer + 1);
+
+    rendererData.statistics.textureCalls++;
+
+    if (rendererData.isInstancing)
     {
-      textureIndex = (float)rendererData.textureSlotIndex;
-      rendererData.textureSlots[rendererData.textureSlotIndex] = textureID;
-      rendererData.textureSlotIndex++;
+      if (rendererData.textureIndexCount != rendererData.segmentedIndexCount)
+        closeTextureSegment();
+
+      QuadInstance& instance = rendererData.quadInstances[rendererData.quadInstanceCount++];
+      instance.corners[0] = { a.x, a.y };
+      instance.corners[1] = { b.x, b.y };
+      instance.corners[2] = { c.x, c.y };
+      instance.corners[3] = { d.x, d.y };
+      instance.texturePosition = texturePosition;
+      instance.color = color;
+      instance.textureIndex = textureIndex;
+      instance.tilingFactor = tilingFactor;
+      return;
     }
 
+    const std::array<glm::vec2, 4> vertices = { { { a.x, a.y }, { b.x, b.y }, { c.x, c.y }, { d.x, d.y } } };
+    const std::array<glm::vec2, 4> textureCoords = { { 
+      { texturePosition.x, texturePosition.y }, 
+      { texturePosition.x + texturePosition.p, texturePosition.y }, 
+      { texturePosition.x + texturePosition.p, texturePosition.y + texturePosition.q }, 
+      { texturePosition.x, texturePosition.y + texturePosition.q } } };
+
     for (uint32_t i = 0; i < 4; i++)
     {
       rendererData.textureBufferPointer->position = vertices[i];
@@ -650,8 +1036,6 @@ namespace flectron
     rendererData.textureIndicesPointer += 6;
 
     rendererData.textureOffset += 4;
-
-    rendererData.statistics.textureCalls++;
   }
 
   void Renderer::triangle(const Vector& a, const Vector& b, const Vector& c, const Color& color)
@@ -661,19 +1045,38 @@ namespace flectron
 
   void Renderer::polygon(const std::vector<Vector>& vertices, const std::vector<size_t>& triangles, const Color& color)
   {
-    int numTriangles = (vertices.size() - 2) * 3;
+    polygon(vertices.data(), vertices.size(), triangles.data(), color);
+  }
+
+  void Renderer::polygon(const Vector* vertices, size_t vertexCount, const size_t* triangles, const Color& color)
+  {
+    int numTriangles = (vertexCount - 2) * 3;
 
-    if (rendererData.textureIndexCount + numTriangles >= MaxIndexCount)
+    if (isQueueing())
     {
-      endTextureBatch();
+      auto& queue = currentQueue();
+      enqueue(queue, RenderCommandType::Polygon, 0, rendererData.whiteTexture, queue.polygons.size());
+      queue.polygons.push_back({ queue.polygonVertices.size(), vertexCount, queue.polygonTriangles.size(), color });
+      queue.polygonVertices.insert(queue.polygonVertices.end(), vertices, vertices + vertexCount);
+      queue.polygonTriangles.insert(queue.polygonTriangles.end(), triangles, triangles + numTriangles);
+      return;
+    }
+
+    const bool isBatchFull = rendererData.textureIndexCount + numTriangles >= MaxIndexCount;
+    if (isBatchFull)
+    {
+      endTextureBatch(FlushReason::BatchFull);
       beginTextureBatch();
     }
 
+    if (rendererData.quadInstanceCount != rendererData.segmentedInstanceCount)
+      closeTextureSegment();
+
     constexpr glm::vec2 textureCoord(0.0f, 0.0f);
     const float whiteTexture = 0.0f;
     const float tilingFactor = 1.0f;
 
-    for (int i = 0; i < vertices.size(); i++)
+    for (size_t i = 0; i < vertexCount; i++)
     {
       rendererData.textureBufferPointer->position = { vertices[i].x, vertices[i].y };
       rendererData.textureBufferPointer->color = { color.r, color.g, color.b, color.a };
@@ -688,7 +1091,7 @@ namespace flectron
       rendererData.textureIndices[rendererData.textureIndexCount++] = triangles[i] + rendererData.textureOffset;
       rendererData.textureIndicesPointer++;
     }
-    rendererData.textureOffset += vertices.size();
+    rendererData.textureOffset += vertexCount;
 
     rendererData.statistics.textureCalls++;
   }
@@ -700,23 +1103,106 @@ namespace flectron
 
   void Renderer::line(const Vector& a, const Vector& b, float thickness, const Color& color)
   {
-    if (rendererData.lineIndexCount + 2 >= MaxIndexCount)
+    const Vector vertices[2] = { a, b };
+    polyline(vertices, 2, thickness, false, color);
+  }
+
+  void Renderer::polyline(const std::vector<Vector>& vertices, float thickness, const Color& color)
+  {
+    polyline(vertices.data(), vertices.size(), thickness, false, color);
+  }
+
+  void Renderer::outline(const std::vector<Vector>& vertices, float thickness, const Color& color)
+  {
+    polyline(vertices.data(), vertices.size(), thickness, true, color);
+  }
+
+  static glm::vec2 lineDirection(const Vector& a, const Vector& b)
+  {
+    const glm::vec2 direction(b.x - a.x, b.y - a.y);
+    const float length = glm::length(direction);
+    return length > 0.0f ? direction / length : glm::vec2(0.0f);
+  }
+
+  static void pushLineVertex(const glm::vec2& position, const glm::vec4& color)
+  {
+    // The line buffer may be write-only mapped memory, so the last vertex is kept aside for degenerate joins
+    rendererData.lastLineVertex.position = position;
+    rendererData.lastLineVertex.color = color;
+    *rendererData.lineBufferPointer = rendererData.lastLineVertex;
+    rendererData.lineBufferPointer++;
+    rendererData.lineIndexCount++;
+  }
+
+  // Every vertex is offset by the thickness to both sides, corners are mitered and open ends are extended like square caps
+  void Renderer::polyline(const Vector* vertices, size_t vertexCount, float thickness, bool isClosed, const Color& color)
+  {
+    if (vertexCount < 2)
+      return;
+
+    if (isQueueing())
     {
-      endLineBatch();
+      auto& queue = currentQueue();
+      enqueue(queue, RenderCommandType::Line, 2, 0, queue.polylines.size());
+      queue.polylines.push_back({ queue.polylineVertices.size(), vertexCount, thickness, isClosed, color });
+      queue.polylineVertices.insert(queue.polylineVertices.end(), vertices, vertices + vertexCount);
+      return;
+    }
+
+    // Two vertices per joint and two more to connect the strip to the previous one
+    const size_t jointCount = isClosed ? vertexCount + 1 : vertexCount;
+    const size_t stripVertexCount = jointCount * 2 + 2;
+    FLECTRON_ASSERT(stripVertexCount <= MaxVertexCount, "Polyline has too many vertices");
+
+    if (rendererData.lineIndexCount + stripVertexCount > MaxVertexCount)
+    {
+      endLineBatch(FlushReason::BatchFull);
       beginLineBatch();
     }
 
-    rendererData.lineBufferPointer->position = { a.x, a.y };
-    rendererData.lineBufferPointer->color = { color.r, color.g, color.b, color.a };
-    rendererData.lineBufferPointer->thickness = thickness;
-    rendererData.lineBufferPointer++;
+    const glm::vec4 lineColor(color.r, color.g, color.b, color.a);
+    const bool isConnected = rendererData.lineIndexCount > 0;
 
-    rendererData.lineBufferPointer->position = { b.x, b.y };
-    rendererData.lineBufferPointer->color = { color.r, color.g, color.b, color.a };
-    rendererData.lineBufferPointer->thickness = thickness;
-    rendererData.lineBufferPointer++;
+    for (size_t i = 0; i < jointCount; i++)
+    {
+      const size_t current = i % vertexCount;
+      glm::vec2 position(vertices[current].x, vertices[current].y);
+      glm::vec2 offset;
 
-    rendererData.lineIndexCount += 2;
+      if (!isClosed && (i == 0 || i == vertexCount - 1))
+      {
+        const glm::vec2 direction = i == 0 ? lineDirection(vertices[0], vertices[1]) : lineDirection(vertices[i - 1], vertices[i]);
+        position += direction * (i == 0 ? -thickness : thickness);
+        offset = glm::vec2(-direction.y, direction.x) * thickness;
+      }
+      else
+      {
+        const glm::vec2 in = lineDirection(vertices[(current + vertexCount - 1) % vertexCount], vertices[current]);
+        const glm::vec2 out = lineDirection(vertices[current], vertices[(current + 1) % vertexCount]);
+        const glm::vec2 normal = glm::vec2(-in.y - out.y, in.x + out.x);
+        const float length = glm::length(normal);
+        if (length > 0.0f)
+        {
+          const glm::vec2 miter = normal / length;
+          const glm::vec2 side = (out.x != 0.0f || out.y != 0.0f) ? out : in;
+          const float along = glm::dot(miter, glm::vec2(-side.y, side.x));
+          offset = miter * std::min(thickness / along, thickness * MiterLimit);
+        }
+        else
+        {
+          offset = glm::vec2(-out.y, out.x) * thickness;
+        }
+      }
+
+      if (i == 0 && isConnected)
+      {
+        const LineVertex previous = rendererData.lastLineVertex;
+        pushLineVertex(previous.position, previous.color);
+        pushLineVertex(position - offset, lineColor);
+      }
+      pushLineVertex(position - offset, lineColor);
+      pushLineVertex(position + offset, lineColor);
+    }
 
     rendererData.statistics.lineCalls++;
   }
@@ -799,9 +1285,38 @@ namespace flectron
 
   void Renderer::ellipse(const Vector& a, const Vector& b, const Vector& c, const Vector& d, float thickness, float fade, const Color& color)
   {
+    if (isQueueing())
+    {
+      auto& queue = currentQueue();
+      enqueue(queue, RenderCommandType::Ellipse, 1, 0, queue.ellipses.size());
+      queue.ellipses.push_back({ { a, b, c, d }, thickness, fade, color });
+      return;
+    }
+
+    rendererData.statistics.circleCalls++;
+
+    if (rendererData.isInstancing)
+    {
+      if (rendererData.circleInstanceCount >= RendererBackend::MaxInstanceCount)
+      {
+        endCircleBatch(FlushReason::BatchFull);
+        beginCircleBatch();
+      }
+
+      CircleInstance& instance = rendererData.circleInstances[rendererData.circleInstanceCount++];
+      instance.corners[0] = { a.x, a.y };
+      instance.corners[1] = { b.x, b.y };
+      instance.corners[2] = { c.x, c.y };
+      instance.corners[3] = { d.x, d.y };
+      instance.color = { color.r, color.g, color.b, color.a };
+      instance.thickness = thickness;
+      instance.fade = fade;
+      return;
+    }
+
     if (rendererData.circleIndexCount + 6 >= MaxIndexCount)
     {
-      endCircleBatch();
+      endCircleBatch(FlushReason::BatchFull);
       beginCircleBatch();
     }
 
@@ -822,46 +1337,96 @@ namespace flectron
     }
 
     rendererData.circleIndexCount += 6;
-
-    rendererData.statistics.circleCalls++;
   }
 
-  void Renderer::text(Ref<FontAtlas>& atlas, const Vector& position, const std::string& text, float scale, const Color& color)
+  template<typename Callback>
+  static void layoutText(const FontAtlas& atlas, const std::string& text, float scale, Callback callback)
   {
-    std::stringstream ss(text);
-    std::string line;
-
-    if (text.size() == 0.0f)
-      return;
-
+    const glm::vec2 offsets = atlas.getOffsets() * scale;
+    float column = 0.0f;
     float lineOffset = 0.0f;
 
-    while(std::getline(ss, line, '\n'))
+    for (char character : text)
     {
-      glm::vec4* texturePositions = new glm::vec4[line.size()];
-      GLuint texture = atlas->get(line, texturePositions);
-      glm::vec2 offsets = atlas->getOffsets() * scale;
-
-      for (float i = 0; i < line.size(); i++)
+      if (character == '\n')
       {
-        quad(
-          {position.x + i * offsets.x, position.y - lineOffset}, 
-          {position.x + (i + 1.0f) * offsets.x, position.y - lineOffset}, 
-          {position.x + (i + 1.0f) * offsets.x, position.y - offsets.y - lineOffset}, 
-          {position.x + i * offsets.x, position.y - offsets.y - lineOffset}, 
-          texture, 
-          texturePositions[static_cast<int>(i)],
-          color
-        );
+        column = 0.0f;
+        lineOffset += offsets.y;
+        continue;
       }
 
-      delete[] texturePositions;
-      lineOffset += offsets.y;
+      callback(TextGlyph{
+        { column * offsets.x, -lineOffset },
+        { (column + 1.0f) * offsets.x, -offsets.y - lineOffset },
+        atlas.getGlyph(character)
+      });
+      column += 1.0f;
+    }
+  }
+
+  static const TextRun& findTextRun(const Ref<FontAtlas>& atlas, const std::string& text, float scale)
+  {
+    size_t hash = std::hash<std::string>()(text);
+    hash ^= std::hash<const FontAtlas*>()(atlas.get()) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<float>()(scale) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+    auto it = rendererData.textRuns.find(hash);
+    if (it != rendererData.textRuns.end())
+    {
+      if (it->second.scale == scale && it->second.text == text && it->second.atlas.lock() == atlas)
+        return it->second;
+    }
+    else if (rendererData.textRuns.size() >= MaxCachedTextRuns)
+    {
+      rendererData.textRuns.clear();
+    }
+
+    // New or colliding key, the run is laid out again in place
+    TextRun& run = rendererData.textRuns[hash];
+    run.atlas = atlas;
+    run.text = text;
+    run.scale = scale;
+    run.glyphs.clear();
+    layoutText(*atlas, text, scale, [&](const TextGlyph& glyph) { run.glyphs.push_back(glyph); });
+    return run;
+  }
+
+  static void textGlyph(const Vector& position, const TextGlyph& glyph, GLuint texture, const Color& color)
+  {
+    Renderer::quad(
+      {position.x + glyph.topLeft.x, position.y + glyph.topLeft.y},
+      {position.x + glyph.bottomRight.x, position.y + glyph.topLeft.y},
+      {position.x + glyph.bottomRight.x, position.y + glyph.bottomRight.y},
+      {position.x + glyph.topLeft.x, position.y + glyph.bottomRight.y},
+      texture,
+      glyph.texturePosition,
+      color
+    );
+  }
+
+  void Renderer::text(Ref<FontAtlas>& atlas, const Vector& position, const std::string& text, float scale, const Color& color)
+  {
+    if (text.empty())
+      return;
+
+    const GLuint texture = atlas->image->getGPU();
+
+    if (text.size() <= MaxUncachedTextLength)
+    {
+      layoutText(*atlas, text, scale, [&](const TextGlyph& glyph) { textGlyph(position, glyph, texture, color); });
+      return;
     }
+
+    std::lock_guard<std::mutex> lock(rendererData.textRunMutex);
+    for (const auto& glyph : findTextRun(atlas, text, scale).glyphs)
+      textGlyph(position, glyph, texture, color);
   }
 
   Renderer::Statistics::Statistics()
-    : textureCalls(0u), circleCalls(0u), lineCalls(0u) 
+    : textureCalls(0u), circleCalls(0u), lineCalls(0u), flushCounts(), reasonCounts(),
+      vertexCount(0u), indexCount(0u), instanceCount(0u), byteCount(0u),
+      cpuMilliseconds(0.0f), sortMilliseconds(0.0f), submitMilliseconds(0.0f), gpuMilliseconds(0.0f),
+      frameStart(std::chrono::steady_clock::now())
   {}
 
   size_t Renderer::Statistics::textureDrawCalls() const { return textureCalls; }
@@ -873,11 +1438,81 @@ namespace flectron
   float Renderer::Statistics::circlePercentage() const { return (float)circleCalls / (float)totalDrawCalls(); }
   float Renderer::Statistics::linePercentage() const { return (float)lineCalls / (float)totalDrawCalls(); }
 
+  size_t Renderer::Statistics::flushes(BatchType type) const { return flushCounts[(size_t)type]; }
+  size_t Renderer::Statistics::flushes(FlushReason reason) const { return reasonCounts[(size_t)reason]; }
+  size_t Renderer::Statistics::vertices() const { return vertexCount; }
+  size_t Renderer::Statistics::indices() const { return indexCount; }
+  size_t Renderer::Statistics::instances() const { return instanceCount; }
+  size_t Renderer::Statistics::uploadedBytes() const { return byteCount; }
+
+  size_t Renderer::Statistics::totalFlushes() const
+  {
+    size_t total = 0;
+    for (size_t count : flushCounts)
+      total += count;
+    return total;
+  }
+
+  float Renderer::Statistics::cpuTime() const { return cpuMilliseconds; }
+  float Renderer::Statistics::buildTime() const { return std::max(0.0f, cpuMilliseconds - sortMilliseconds - submitMilliseconds); }
+  float Renderer::Statistics::sortTime() const { return sortMilliseconds; }
+  float Renderer::Statistics::submitTime() const { return submitMilliseconds; }
+  float Renderer::Statistics::gpuTime() const { return gpuMilliseconds; }
+
+  const RollingStatistic& Renderer::Statistics::cpuTimes() const { return cpuHistory; }
+  const RollingStatistic& Renderer::Statistics::buildTimes() const { return buildHistory; }
+  const RollingStatistic& Renderer::Statistics::submitTimes() const { return submitHistory; }
+  const RollingStatistic& Renderer::Statistics::gpuTimes() const { return gpuHistory; }
+  const RollingStatistic& Renderer::Statistics::flushesPerFrame() const { return flushHistory; }
+  const RollingStatistic& Renderer::Statistics::bytesPerFrame() const { return byteHistory; }
+
+  void Renderer::Statistics::recordFlush(BatchType type, FlushReason reason, size_t vertices, size_t indices, size_t instances, size_t bytes, std::chrono::steady_clock::time_point start)
+  {
+    submitMilliseconds += elapsedMilliseconds(start);
+    flushCounts[(size_t)type]++;
+    reasonCounts[(size_t)reason]++;
+    vertexCount += vertices;
+    indexCount += indices;
+    instanceCount += instances;
+    byteCount += bytes;
+  }
+
+  void Renderer::Statistics::endFrame()
+  {
+    cpuMilliseconds = elapsedMilliseconds(frameStart);
+    cpuHistory.add(cpuMilliseconds);
+    buildHistory.add(buildTime());
+    submitHistory.add(submitMilliseconds);
+    flushHistory.add((float)totalFlushes());
+    byteHistory.add((float)byteCount);
+  }
+
+  // The GPU time is kept since its result belongs to an earlier frame anyway
   void Renderer::Statistics::reset()
   {
     textureCalls = 0u;
     circleCalls = 0u;
     lineCalls = 0u;
+    flushCounts.fill(0u);
+    reasonCounts.fill(0u);
+    vertexCount = 0u;
+    indexCount = 0u;
+    instanceCount = 0u;
+    byteCount = 0u;
+    cpuMilliseconds = 0.0f;
+    sortMilliseconds = 0.0f;
+    submitMilliseconds = 0.0f;
+    frameStart = std::chrono::steady_clock::now();
+  }
+
+  void Renderer::Statistics::clearHistory()
+  {
+    cpuHistory.clear();
+    buildHistory.clear();
+    submitHistory.clear();
+    gpuHistory.clear();
+    flushHistory.clear();
+    byteHistory.clear();
   }
 
   Renderer::Statistics& Renderer::statistics() { return rendererData.statistics; }
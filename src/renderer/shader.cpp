@@ -10,7 +10,14 @@
 namespace flectron 
 {
 
+  UniformName::UniformName(const std::string& name)
+    : hash(hashUniformName(name.data(), name.size())), name(name.c_str())
+  {
+  }
+
   GLint Shader::maxUniformBlockBinings = 0;
+  Scope<ProgramCache> Shader::programCache = nullptr;
+  std::string Shader::driver;
   Shader::WorkGroupInfo Shader::workGroupInfo = { 0, 0, 0, 0, 0, 0, 0 };
 
   Shader::~Shader()
@@ -33,91 +40,203 @@ namespace flectron
     return rendererID;
   }
 
+  void Shader::setUniform1i(int location, int value)
+  {
+    glUniform1i(location, value);
+  }
+
+  void Shader::setUniform1f(int location, float value)
+  {
+    glUniform1f(location, value);
+  }
+
+  void Shader::setUniform2f(int location, float v1, float v2)
+  {
+    glUniform2f(location, v1, v2);
+  }
+
+  void Shader::setUniform4f(int location, float v0, float v1, float v2, float v3)
+  {
+    glUniform4f(location, v0, v1, v2, v3);
+  }
+
+  void Shader::setUniformMat4f(int location, const glm::mat4& matrix)
+  {
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+  }
+
+  void Shader::setUniform1iv(int location, int* array, int size)
+  {
+    glUniform1iv(location, size, array);
+  }
+
+  void Shader::setUniform2fv(int location, float* array, int size)
+  {
+    glUniform2fv(location, size, array);
+  }
+
+  void Shader::setUniform3fv(int location, float* array, int size)
+  {
+    glUniform3fv(location, size, array);
+  }
+
+  void Shader::setUniform4fv(int location, float* array, int size)
+  {
+    glUniform4fv(location, size, array);
+  }
+
+  void Shader::setUniform1i(const UniformName& name, int value)
+  {
+    setUniform1i(getUniformLocation(name), value);
+  }
+
+  void Shader::setUniform1f(const UniformName& name, float value)
+  {
+    setUniform1f(getUniformLocation(name), value);
+  }
+
+  void Shader::setUniform2f(const UniformName& name, float v1, float v2)
+  {
+    setUniform2f(getUniformLocation(name), v1, v2);
+  }
+
+  void Shader::setUniform4f(const UniformName& name, float v0, float v1, float v2, float v3)
+  {
+    setUniform4f(getUniformLocation(name), v0, v1, v2, v3);
+  }
+
+  void Shader::setUniformMat4f(const UniformName& name, const glm::mat4& matrix)
+  {
+    setUniformMat4f(getUniformLocation(name), matrix);
+  }
+
+  void Shader::setUniform1iv(const UniformName& name, int* array, int size)
+  {
+    setUniform1iv(getUniformLocation(name), array, size);
+  }
+
+  void Shader::setUniform2fv(const UniformName& name, float* array, int size)
+  {
+    setUniform2fv(getUniformLocation(name), array, size);
+  }
+
+  void Shader::setUniform3fv(const UniformName& name, float* array, int size)
+  {
+    setUniform3fv(getUniformLocation(name), array, size);
+  }
+
+  void Shader::setUniform4fv(const UniformName& name, float* array, int size)
+  {
+    setUniform4fv(getUniformLocation(name), array, size);
+  }
+
   void Shader::setUniform1i(const std::string& name, int value)
   {
-    glUniform1i(getUniformLocation(name), value);
+    setUniform1i(UniformName(name), value);
   }
 
   void Shader::setUniform1f(const std::string& name, float value)
   {
-    glUniform1f(getUniformLocation(name), value);
+    setUniform1f(UniformName(name), value);
   }
-  
+
   void Shader::setUniform2f(const std::string& name, float v1, float v2)
   {
-    glUniform2f(getUniformLocation(name), v1, v2);
+    setUniform2f(UniformName(name), v1, v2);
   }
 
   void Shader::setUniform4f(const std::string& name, float v0, float v1, float v2, float v3)
   {
-    glUniform4f(getUniformLocation(name), v0, v1, v2, v3);
+    setUniform4f(UniformName(name), v0, v1, v2, v3);
   }
 
   void Shader::setUniformMat4f(const std::string& name, const glm::mat4& matrix)
   {
-    glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
+    setUniformMat4f(UniformName(name), matrix);
   }
 
   void Shader::setUniform1iv(const std::string& name, int* array, int size)
   {
-    glUniform1iv(getUniformLocation(name), size, array);
+    setUniform1iv(UniformName(name), array, size);
   }
 
   void Shader::setUniform2fv(const std::string& name, float* array, int size)
   {
-    glUniform2fv(getUniformLocation(name), size, array);
+    setUniform2fv(UniformName(name), array, size);
   }
 
   void Shader::setUniform3fv(const std::string& name, float* array, int size)
   {
-    glUniform3fv(getUniformLocation(name), size, array);
+    setUniform3fv(UniformName(name), array, size);
   }
 
   void Shader::setUniform4fv(const std::string& name, float* array, int size)
   {
-    glUniform4fv(getUniformLocation(name), size, array);
+    setUniform4fv(UniformName(name), array, size);
   }
 
-  void Shader::setUniformBlock(const std::string& name, GLuint ubo)
+  void Shader::setUniformBlock(const UniformName& name, GLuint ubo)
   {
     GLuint binding = getUniformBlockBinding(name);
     glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
     glUniformBlockBinding(rendererID, getUniformBlockIndex(name), binding);
   }
 
-  int Shader::getUniformLocation(const std::string& name)
+  void Shader::setUniformBlock(const std::string& name, GLuint ubo)
+  {
+    setUniformBlock(UniformName(name), ubo);
+  }
+
+  // Missing uniforms are cached as -1 too, so a hit is reported apart from the location
+  bool Shader::findCachedLocation(std::unordered_map<uint32_t, CachedLocation>& cache, const UniformName& name, int& location)
   {
-    if (locationCache.find(name) != locationCache.end())
-      return locationCache[name];
+    auto it = cache.find(name.hash);
+    if (it == cache.end())
+      return false;
+
+#if FLECTRON_ENABLE_DEBUG
+    FLECTRON_ASSERT(it->second.name == name.name, "Uniform names " + it->second.name + " and " + name.name + " have the same hash");
+#endif
+    location = it->second.location;
+    return true;
+  }
 
-    int location = glGetUniformLocation(this->rendererID, name.c_str());
-    FLECTRON_ASSERT(location != -1, "Uniform " + name + " not found");
+  int Shader::getUniformLocation(const UniformName& name)
+  {
+    int location;
+    if (findCachedLocation(locationCache, name, location))
+      return location;
+
+    location = glGetUniformLocation(this->rendererID, name.name);
+    FLECTRON_ASSERT(location != -1, std::string("Uniform ") + name.name + " not found");
     
-    locationCache[name] = location;
+    locationCache.emplace(name.hash, CachedLocation{ location, name.name });
     return location;
   }
 
-  int Shader::getUniformBlockIndex(const std::string& name)
+  int Shader::getUniformBlockIndex(const UniformName& name)
   {
-    if (locationCache.find(name) != locationCache.end())
-      return locationCache[name];
+    int index;
+    if (findCachedLocation(blockIndexCache, name, index))
+      return index;
 
-    int location = glGetUniformBlockIndex(this->rendererID, name.c_str());
-    FLECTRON_ASSERT(location != -1, "Uniform block " + name + " not found");
+    index = (int)glGetUniformBlockIndex(this->rendererID, name.name);
+    FLECTRON_ASSERT(index != (int)GL_INVALID_INDEX, std::string("Uniform block ") + name.name + " not found");
 
-    locationCache[name] = location;
-    return location;
+    blockIndexCache.emplace(name.hash, CachedLocation{ index, name.name });
+    return index;
   }
 
-  GLuint Shader::getUniformBlockBinding(const std::string& name)
+  GLuint Shader::getUniformBlockBinding(const UniformName& name)
   {
-    if (uniformBlockBindings.find(name) != uniformBlockBindings.end())
-      return uniformBlockBindings[name];
+    auto it = uniformBlockBindings.find(name.hash);
+    if (it != uniformBlockBindings.end())
+      return it->second;
 
     GLuint binding = uniformBlockBindings.size();
     FLECTRON_ASSERT(binding < maxUniformBlockBinings, "Maximum number of uniform block bindings reached");
     
-    uniformBlockBindings[name] = binding;
+    uniformBlockBindings.emplace(name.hash, binding);
     return binding;
   }
 
@@ -185,7 +304,7 @@ namespace flectron
   }
 
   Shader::Shader()
-    : rendererID(0u), locationCache(), shaders({ nullptr, nullptr, nullptr, nullptr })
+    : rendererID(0u), locationCache(), blockIndexCache(), shaders({ nullptr, nullptr, nullptr, nullptr })
   {
     FLECTRON_LOG_TRACE("Creating empty shader");
     rendererID = glCreateProgram();
@@ -193,20 +312,31 @@ namespace flectron
   }
 
   Shader::Shader(const Shaders& shaders)
-    : rendererID(0u), locationCache(), shaders(shaders)
+    : rendererID(0u), locationCache(), blockIndexCache(), shaders(shaders)
   {
     FLECTRON_LOG_TRACE("Creating shader");
     rendererID = glCreateProgram();
-
-    ShadersAttacher attacher(rendererID, shaders);
-
-    linkAndValidate();
+    build();
   }
 
   void Shader::init()
   {
     maxUniformBlockBinings = getMaxUniformBlockBinings();
     workGroupInfo = getWorkGroupInfo();
+
+    driver = std::string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+
+    GLint binaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    if (binaryFormats == 0)
+    {
+      FLECTRON_LOG_DEBUG("Driver does not support program binaries, shaders will always be compiled");
+      programCache = nullptr;
+    }
+    else if (FLECTRON_PROGRAM_CACHE && !programCache)
+    {
+      programCache = createScope<FileProgramCache>(FLECTRON_PROGRAM_CACHE_DIRECTORY);
+    }
   }
 
   Ref<Shader> Shader::create(const Shaders& shaders)
@@ -214,6 +344,77 @@ namespace flectron
     return createRef<Shader>(shaders);
   }
 
+  Scope<ProgramCache> Shader::setProgramCache(Scope<ProgramCache> cache)
+  {
+    Scope<ProgramCache> previous = std::move(programCache);
+    programCache = std::move(cache);
+    return previous;
+  }
+
+  ProgramCache* Shader::getProgramCache()
+  {
+    return programCache.get();
+  }
+
+  void Shader::build()
+  {
+    const uint64_t key = getCacheKey();
+    if (loadBinary(key))
+      return;
+
+    {
+      ShadersAttacher attacher(rendererID, shaders);
+      if (programCache)
+        glProgramParameteri(rendererID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      linkAndValidate();
+    }
+
+    storeBinary(key);
+  }
+
+  uint64_t Shader::getCacheKey() const
+  {
+    auto source = [](const TextView& view) { return view ? (std::string_view)view : std::string_view(); };
+    return ProgramCache::key(driver, { source(shaders.vertex), source(shaders.geometry), source(shaders.fragment), source(shaders.compute) });
+  }
+
+  bool Shader::loadBinary(uint64_t key)
+  {
+    ProgramCache::Binary binary;
+    if (!programCache || !programCache->load(key, binary))
+      return false;
+
+    glProgramBinary(rendererID, binary.format, binary.data.data(), (GLsizei)binary.data.size());
+
+    GLint success = GL_FALSE;
+    glGetProgramiv(rendererID, GL_LINK_STATUS, &success);
+    if (success == GL_FALSE)
+    {
+      FLECTRON_LOG_DEBUG("Cached shader program was rejected by the driver, compiling it instead");
+      return false;
+    }
+
+    FLECTRON_LOG_TRACE("Loaded shader program from the cache");
+    return true;
+  }
+
+  void Shader::storeBinary(uint64_t key)
+  {
+    if (!programCache)
+      return;
+
+    GLint length = 0;
+    glGetProgramiv(rendererID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+      return;
+
+    ProgramCache::Binary binary;
+    binary.data.resize((size_t)length);
+    glGetProgramBinary(rendererID, length, &length, &binary.format, binary.data.data());
+    binary.data.resize((size_t)length);
+    programCache->store(key, binary);
+  }
+
   void Shader::addShader(ShaderType type, const TextView& source)
   {
     switch (type)
@@ -247,10 +448,9 @@ namespace flectron
     FLECTRON_LOG_TRACE("Reloading shader");
     glDeleteProgram(rendererID);
     rendererID = glCreateProgram();
-
-    ShadersAttacher attacher(rendererID, shaders);
-
-    linkAndValidate();
+    locationCache.clear();
+    blockIndexCache.clear();
+    build();
   }
 
   void Shader::resetUniformBlockBindings()
@@ -0,0 +1,37 @@
+#version 450 core
+
+layout(location = 0) in vec2 cornerA;
+layout(location = 1) in vec2 cornerB;
+layout(location = 2) in vec2 cornerC;
+layout(location = 3) in vec2 cornerD;
+layout(location = 4) in vec4 color;
+layout(location = 5) in float thickness;
+layout(location = 6) in float fade;
+
+layout (std140) uniform CameraBlock
+{
+  mat4 uViewProjection;
+};
+
+uniform float uZIndex;
+
+out vec2 vLocalPosition;
+out vec4 vColor;
+out float vThickness;
+out float vFade;
+
+const int indices[6] = int[](0, 1, 2, 2, 3, 0);
+const vec2 localPositions[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main()
+{
+  int corner = indices[gl_VertexID];
+  vec2 corners[4] = vec2[](cornerA, cornerB, cornerC, cornerD);
+
+  vLocalPosition = localPositions[corner];
+  vColor = color;
+  vThickness = thickness;
+  vFade = fade;
+
+  gl_Position = uViewProjection * vec4(corners[corner], uZIndex, 1.0);
+}
@@ -10,9 +10,24 @@ uniform vec2 uCameraPosition;
 uniform vec2 uWindowSize;
 uniform vec4 uBaseColor;
 
-uniform vec4 uLightColor[128];
-uniform vec3 uLightData[128];
-uniform int uLightCount;
+// Every light takes two texels, its position and radius followed by its color
+uniform samplerBuffer uLights;
+
+// Offset and count of every tile, followed by the light indices they point to
+uniform isamplerBuffer uTileLights;
+uniform int uTileColumns;
+uniform int uTileRows;
+
+// One row of polar occluder distances per light, relative to its radius
+uniform sampler2D uShadowMaps;
+uniform int uShadowResolution;
+
+float shadowDistance(int light, vec2 direction)
+{
+  float angle = atan(direction.y, direction.x);
+  int column = int((angle + 3.14159265) / 6.28318531 * float(uShadowResolution)) % uShadowResolution;
+  return texelFetch(uShadowMaps, ivec2(column, light), 0).r;
+}
 
 void main()
 {    
@@ -25,14 +40,25 @@ void main()
   float weights = 0;
   float maxWeight = 0.0;
   vec4 combinedColor = vec4(0.0, 0.0, 0.0, 0.0);
-  for (int i = 0; i < uLightCount; i++) 
+
+  ivec2 tile = min(ivec2(vTextureCoord * vec2(uTileColumns, uTileRows)), ivec2(uTileColumns - 1, uTileRows - 1));
+  int tileIndex = tile.y * uTileColumns + tile.x;
+  int offset = texelFetch(uTileLights, tileIndex * 2).r;
+  int count = texelFetch(uTileLights, tileIndex * 2 + 1).r;
+
+  for (int i = 0; i < count; i++) 
   {
-    float dist = distance(uLightData[i].xy, coords);
-    if (dist < uLightData[i].z)
+    int light = texelFetch(uTileLights, offset + i).r;
+    vec4 lightData = texelFetch(uLights, light * 2);
+    float dist = distance(lightData.xy, coords);
+    if (lightData.w > 0.0 && dist > lightData.z * shadowDistance(light, coords - lightData.xy))
+      continue;
+
+    if (dist < lightData.z)
     {
-      float x = dist / uLightData[i].z;
+      float x = dist / lightData.z;
       float weight = 1.0 - x*x*x;
-      combinedColor += uLightColor[i] * weight;
+      combinedColor += texelFetch(uLights, light * 2 + 1) * weight;
       weights += weight;
       if (weight > maxWeight)
       {
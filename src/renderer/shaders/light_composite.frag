@@ -0,0 +1,29 @@
+#version 330 core
+
+layout(location = 0) out vec4 color;
+
+in vec2 vTextureCoord;
+uniform sampler2D uRendererTexture;
+uniform sampler2D uLightMap;
+uniform sampler2D uLightMapWeight;
+uniform float uDarkness;
+
+uniform vec4 uBaseColor;
+
+void main()
+{
+  vec4 lightColor = uBaseColor;
+  vec4 light = texture(uLightMap, vTextureCoord);
+  float maxWeight = texture(uLightMapWeight, vTextureCoord).r;
+
+  if (light.a > 0.0)
+  {
+    lightColor = mix(vec4(uBaseColor.rgb, 1.0), vec4(light.rgb / light.a, 1.0), maxWeight);
+  }
+
+  color = mix(
+    texture(uRendererTexture, vTextureCoord), 
+    texture(uRendererTexture, vTextureCoord) * vec4(lightColor.rgb, uBaseColor.a), 
+    uDarkness
+  );
+}
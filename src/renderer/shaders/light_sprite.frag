@@ -0,0 +1,36 @@
+#version 330 core
+
+// Light colors weighted by their falloff are summed up, with the summed weights in alpha
+layout(location = 0) out vec4 color;
+// Blended with GL_MAX to keep the strongest falloff
+layout(location = 1) out float maxWeight;
+
+in vec2 vLocalPosition;
+in vec4 vColor;
+in float vShadow;
+flat in int vLight;
+
+// One row of polar occluder distances per light, relative to its radius
+uniform sampler2D uShadowMaps;
+uniform int uShadowResolution;
+
+float shadowDistance(int light, vec2 direction)
+{
+  float angle = atan(direction.y, direction.x);
+  int column = int((angle + 3.14159265) / 6.28318531 * float(uShadowResolution)) % uShadowResolution;
+  return texelFetch(uShadowMaps, ivec2(column, light), 0).r;
+}
+
+void main()
+{
+  float x = length(vLocalPosition);
+  if (x >= 1.0)
+    discard;
+
+  if (vShadow > 0.0 && x > shadowDistance(vLight, vLocalPosition))
+    discard;
+
+  float weight = 1.0 - x*x*x;
+  color = vec4(vColor.rgb * weight, weight);
+  maxWeight = weight;
+}
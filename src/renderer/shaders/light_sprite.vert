@@ -0,0 +1,24 @@
+#version 330 core
+
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec4 light;
+layout(location = 2) in vec4 color;
+
+uniform vec2 uCameraPosition;
+uniform vec2 uWindowSize;
+
+out vec2 vLocalPosition;
+out vec4 vColor;
+out float vShadow;
+flat out int vLight;
+
+void main()
+{
+  vLocalPosition = corner;
+  vColor = color;
+  vShadow = light.w;
+  vLight = gl_InstanceID;
+
+  vec2 worldPosition = light.xy + corner * light.z;
+  gl_Position = vec4((worldPosition - uCameraPosition) * 2.0 / uWindowSize, 0.0, 1.0);
+}
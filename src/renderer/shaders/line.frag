@@ -2,9 +2,9 @@
 
 layout(location = 0) out vec4 color;
 
-in vec4 fColor;
+in vec4 vColor;
 
 void main()
 {
-  color = fColor;
+  color = vColor;
 }
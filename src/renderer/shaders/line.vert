@@ -2,14 +2,18 @@
 
 layout(location = 0) in vec2 position;
 layout(location = 1) in vec4 color;
-layout(location = 2) in float thickness;
+
+layout (std140) uniform CameraBlock
+{
+  mat4 uViewProjection;
+};
+
+uniform float uZIndex;
 
 out vec4 vColor;
-out float vThickness;
 
 void main()
 {
   vColor = color;
-  vThickness = thickness;
-  gl_Position = vec4(position, 0.0, 1.0);
+  gl_Position = uViewProjection * vec4(position, uZIndex, 1.0);
 }
@@ -9,8 +9,12 @@ in float vTilingFactor;
 
 // TODO set this value dynamicaly not hardcoded
 uniform sampler2D uTextures[32];
+uniform sampler2DArray uTextureArray;
 
 void main()
 {
-  color = texture(uTextures[int(vTextureIndex)], vTextureCoord * vTilingFactor) * vColor;
+  if (vTextureIndex < 0.0)
+    color = texture(uTextureArray, vec3(vTextureCoord * vTilingFactor, -vTextureIndex - 1.0)) * vColor;
+  else
+    color = texture(uTextures[int(vTextureIndex)], vTextureCoord * vTilingFactor) * vColor;
 }
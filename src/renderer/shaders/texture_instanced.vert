@@ -0,0 +1,37 @@
+#version 450 core
+
+layout(location = 0) in vec2 cornerA;
+layout(location = 1) in vec2 cornerB;
+layout(location = 2) in vec2 cornerC;
+layout(location = 3) in vec2 cornerD;
+layout(location = 4) in vec4 texturePosition;
+layout(location = 5) in vec4 color;
+layout(location = 6) in float textureIndex;
+layout(location = 7) in float tilingFactor;
+
+layout (std140) uniform CameraBlock
+{
+  mat4 uViewProjection;
+};
+
+uniform float uZIndex;
+
+out vec4 vColor;
+out vec2 vTextureCoord;
+out float vTextureIndex;
+out float vTilingFactor;
+
+const int indices[6] = int[](0, 1, 2, 2, 3, 0);
+const vec2 unitCoords[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main()
+{
+  int corner = indices[gl_VertexID];
+  vec2 corners[4] = vec2[](cornerA, cornerB, cornerC, cornerD);
+
+  vColor = color;
+  vTextureCoord = texturePosition.xy + unitCoords[corner] * texturePosition.zw;
+  vTextureIndex = textureIndex;
+  vTilingFactor = tilingFactor;
+  gl_Position = uViewProjection * vec4(corners[corner], uZIndex, 1.0);
+}
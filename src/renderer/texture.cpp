@@ -25,6 +25,59 @@ namespace flectron
     return fbo;
   }
 
+  TextureArray::TextureArray(int width, int height, int capacity, const Image::Parameters& parameters)
+    : textureID(0u), width(width), height(height), capacity(capacity), layers()
+  {
+    FLECTRON_LOG_TRACE("Creating texture array");
+    FLECTRON_LOG_DEBUG("\t{}x{} with {} layers", width, height, capacity);
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &textureID);
+    glTextureStorage3D(textureID, 1, GL_RGBA8, width, height, capacity);
+    for (auto& [key, value] : parameters)
+      glTextureParameteri(textureID, key, value);
+  }
+
+  TextureArray::~TextureArray()
+  {
+    glDeleteTextures(1, &textureID);
+  }
+
+  int TextureArray::add(const Image& image)
+  {
+    FLECTRON_ASSERT(image.isLoaded(), "Image is not loaded");
+    FLECTRON_ASSERT(image.width == width && image.height == height, "Image does not match the size of the texture array");
+
+    auto it = layers.find(image.getGPU());
+    if (it != layers.end())
+      return it->second;
+
+    if (layers.size() >= (size_t)capacity)
+    {
+      FLECTRON_LOG_WARN("Texture array is full, texture {} will take a texture slot instead", image.getGPU());
+      return -1;
+    }
+
+    const int layer = (int)layers.size();
+    glTextureSubImage3D(textureID, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.data);
+    layers[image.getGPU()] = layer;
+    return layer;
+  }
+
+  int TextureArray::getLayer(GLuint texture) const
+  {
+    auto it = layers.find(texture);
+    return it != layers.end() ? it->second : -1;
+  }
+
+  GLuint TextureArray::getGPU() const
+  {
+    return textureID;
+  }
+
+  size_t TextureArray::size() const
+  {
+    return layers.size();
+  }
+
   TextureAtlas::TextureAtlas(const Image& image, int columns, int rows) : TextureAtlas(static_cast<ImageView>(image), columns, rows) {}
 
   TextureAtlas::TextureAtlas(const ImageView& image, int columns, int rows)
@@ -51,26 +104,27 @@ namespace flectron
     : TextureAtlas(image, columns, rows), alphabet(alphabet)
   {
     FLECTRON_LOG_TRACE("Creating font atlas");
+    glyphs.fill({ 0.0f, 0.0f, xOffset, yOffset });
     for (size_t i = 0; i < alphabet.size(); i++)
-      indexMap[(char)alphabet[i]] = (int)i;
+    {
+      int x = (int)i % columns;
+      int y = (int)i / columns;
+      glyphs[(unsigned char)alphabet[i]] = { xOffset * (float)x, yOffset * (float)y, xOffset, yOffset };
+    }
   }
 
-  GLuint FontAtlas::get(const std::string& text, glm::vec4* texturePositions)
+  GLuint FontAtlas::get(const std::string& text, glm::vec4* texturePositions) const
   {
     for (size_t i = 0; i < text.size(); i++)
-    {
-      int index = indexMap[(char)text[i]];
-      int x = index % columns;
-      int y = index / columns;
-
-      texturePositions[i].x = xOffset * (float)x;
-      texturePositions[i].y = yOffset * (float)y;
-      texturePositions[i].p = xOffset;
-      texturePositions[i].q = yOffset;
-    }
+      texturePositions[i] = getGlyph(text[i]);
     return image->getGPU();
   }
 
+  const glm::vec4& FontAtlas::getGlyph(char character) const
+  {
+    return glyphs[(unsigned char)character];
+  }
+
   glm::vec2 FontAtlas::getOffsets() const
   {
     return { xOffset, yOffset };
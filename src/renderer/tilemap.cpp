@@ -0,0 +1,123 @@
+#include <flectron/renderer/tilemap.hpp>
+
+#include <algorithm>
+#include <flectron/assert/assert.hpp>
+#include <flectron/utils/profile.hpp>
+
+namespace flectron
+{
+
+  Tile::Tile(GLuint texture, const glm::vec4& textureCoords, const glm::vec4& ab, const glm::vec4& cd) 
+    : texture(texture), textureCoords(textureCoords), ab(ab), cd(cd) 
+  {}
+
+  void Tile::render(const Vector& position, float size, const Color& color) const
+  {
+    Renderer::quad(
+      {position.x + ab.x * size, position.y + ab.y * size},
+      {position.x + ab.z * size, position.y + ab.w * size},
+      {position.x + cd.x * size, position.y + cd.y * size},
+      {position.x + cd.z * size, position.y + cd.w * size},
+      texture,
+      textureCoords,
+      color);
+  }
+
+  Tilemap::Tilemap(size_t width, size_t height, float tileSize, const Vector& position)
+    : width(width), height(height), tileSize(tileSize), position(position), tiles(width * height, nullptr),
+      columns((width + ChunkSize - 1) / ChunkSize), rows((height + ChunkSize - 1) / ChunkSize), chunks(columns * rows)
+  {}
+
+  Tilemap::~Tilemap()
+  {
+    for (auto& chunk : chunks)
+      if (chunk.batch != 0)
+        Renderer::destroyStaticBatch(chunk.batch);
+  }
+
+  void Tilemap::set(size_t x, size_t y, const Tile* tile)
+  {
+    FLECTRON_ASSERT(x < width && y < height, "Tile is outside of the tilemap");
+    const Tile*& current = tiles[y * width + x];
+    if (current == tile)
+      return;
+
+    current = tile;
+    chunks[(y / ChunkSize) * columns + x / ChunkSize].isDirty = true;
+  }
+
+  const Tile* Tilemap::get(size_t x, size_t y) const
+  {
+    FLECTRON_ASSERT(x < width && y < height, "Tile is outside of the tilemap");
+    return tiles[y * width + x];
+  }
+
+  size_t Tilemap::getWidth() const
+  {
+    return width;
+  }
+
+  size_t Tilemap::getHeight() const
+  {
+    return height;
+  }
+
+  void Tilemap::invalidate()
+  {
+    for (auto& chunk : chunks)
+      chunk.isDirty = true;
+  }
+
+  void Tilemap::render()
+  {
+    for (size_t row = 0; row < rows; row++)
+      for (size_t column = 0; column < columns; column++)
+        renderChunk(column, row);
+  }
+
+  // Only the range of chunks overlapping the constraints is visited
+  void Tilemap::render(const Constraints& constraints)
+  {
+    FLECTRON_PROFILE_EVENT("Tilemap::render");
+    const float chunkSize = tileSize * (float)ChunkSize;
+    const float left = (constraints.left - position.x) / chunkSize;
+    const float right = (constraints.right - position.x) / chunkSize;
+    const float top = (constraints.top - position.y) / chunkSize;
+    const float bottom = (constraints.bottom - position.y) / chunkSize;
+
+    if (right < 0.0f || bottom < 0.0f || left >= (float)columns || top >= (float)rows)
+      return;
+
+    const size_t minColumn = (size_t)std::max(left, 0.0f);
+    const size_t maxColumn = std::min((size_t)right, columns - 1);
+    const size_t minRow = (size_t)std::max(top, 0.0f);
+    const size_t maxRow = std::min((size_t)bottom, rows - 1);
+
+    for (size_t row = minRow; row <= maxRow; row++)
+      for (size_t column = minColumn; column <= maxColumn; column++)
+        renderChunk(column, row);
+  }
+
+  void Tilemap::renderChunk(size_t column, size_t row)
+  {
+    Chunk& chunk = chunks[row * columns + column];
+    if (chunk.isDirty)
+    {
+      if (chunk.batch != 0)
+        Renderer::destroyStaticBatch(chunk.batch);
+
+      Renderer::beginStaticBatch();
+      const size_t maxX = std::min((column + 1) * ChunkSize, width);
+      const size_t maxY = std::min((row + 1) * ChunkSize, height);
+      for (size_t y = row * ChunkSize; y < maxY; y++)
+        for (size_t x = column * ChunkSize; x < maxX; x++)
+          if (const Tile* tile = tiles[y * width + x])
+            tile->render({ position.x + (float)x * tileSize, position.y + (float)y * tileSize }, tileSize);
+      chunk.batch = Renderer::endStaticBatch();
+      chunk.isDirty = false;
+    }
+
+    Renderer::drawStaticBatch(chunk.batch);
+  }
+
+}
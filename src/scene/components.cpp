@@ -12,9 +12,24 @@ namespace flectron
 {
 
   TagComponent::TagComponent(Entity entity, const std::string& tag)
-    : tag(tag) 
+    : TagComponent(entity, Tags::intern(tag))
   {}
 
+  TagComponent::TagComponent(Entity entity, TagID id)
+    : entity(entity), id(id), indexedID(id)
+  {}
+
+  const std::string& TagComponent::tag() const
+  {
+    return Tags::name(id);
+  }
+
+  void TagComponent::setTag(const std::string& tag)
+  {
+    id = Tags::intern(tag);
+    entity.patch<TagComponent>();
+  }
+
   UUIDComponent::UUIDComponent(Entity entity)
     : entity(entity), uuid(randomUUID())
   {}
@@ -263,7 +278,7 @@ namespace flectron
   }
 
   SpatialHashGridComponent::SpatialHashGridComponent(Entity entity, const std::pair<std::pair<int,int>, std::pair<int,int>>& clientIndices, int clientQuery)
-    : entity(entity), clientIndices(clientIndices), clientQuery(clientQuery)
+    : entity(entity), clientIndices(clientIndices), clientQuery(clientQuery), isStale(false)
   {}
 
   FillComponent::FillComponent(Entity entity)
@@ -361,14 +376,49 @@ namespace flectron
     : entity(entity), lightRadius(lightRadius), lightColor(lightColor)
   {}
 
+  ShadowComponent::ShadowComponent(Entity entity)
+    : entity(entity), shadowMap(), position(), radius(0.0f), isDirty(true)
+  {}
+
+  OccluderComponent::OccluderComponent(Entity entity)
+    : entity(entity), bounds(0.0f, 0.0f, 0.0f, 0.0f), isDirty(true)
+  {}
+
   TemporaryComponent::TemporaryComponent(Entity entity)
     : entity(entity)
   {}
 
+  InactiveComponent::InactiveComponent(Entity entity)
+    : entity(entity)
+  {}
+
+  TilemapComponent::TilemapComponent(Entity entity, const Ref<Tilemap>& tilemap)
+    : entity(entity), tilemap(tilemap)
+  {}
+
+  StaticComponent::StaticComponent(Entity entity)
+    : entity(entity)
+  {}
+
+  PooledComponent::PooledComponent(Entity entity, EntityPool* pool)
+    : entity(entity), pool(pool)
+  {}
+
   ScriptComponent::ScriptComponent(Entity entity, std::function<void()> callback, int order)
     : entity(entity), callback(callback), order(order)
   {}
 
+  int ScriptComponent::getOrder() const
+  {
+    return order;
+  }
+
+  void ScriptComponent::setOrder(int order)
+  {
+    this->order = order;
+    entity.patch<ScriptComponent>();
+  }
+
   SerializationComponent::SerializationComponent(Entity entity, std::function<void(std::vector<char>&, Entity)> serializer)
     : entity(entity), serializer(serializer)
   {}
@@ -18,6 +18,11 @@ namespace flectron {
     entityHandle = entt::null;
   }
 
+  entt::entity Entity::getHandle() const
+  {
+    return entityHandle;
+  }
+
   Entity::operator bool() const 
   {
     return entityHandle != entt::null;
@@ -58,9 +63,7 @@ namespace flectron {
       }
       else
       {
-        auto& vertices = vc.getTransformedVertices(pc);
-        for (int j = 0; j < vertices.size(); j++)
-          Renderer::line(vertices[j], vertices[(j + 1) % vertices.size()], sc.strokeWidth, sc.strokeColor);
+        Renderer::outline(vc.getTransformedVertices(pc), sc.strokeWidth, sc.strokeColor);
       }
     }
 
@@ -4,7 +4,7 @@ namespace flectron
 {
 
   SpatialHashGrid::SpatialHashGrid(int cellSize, entt::registry& registry)
-    : cells(), cellSize(cellSize), queryIdentifier(0), registry(registry)
+    : cells(), cellSize(cellSize), queryIdentifier(0), staleEntities(), registry(registry)
   {}
 
   void SpatialHashGrid::insert(entt::entity entity)
@@ -19,6 +19,7 @@ namespace flectron
     if (registry.all_of<SpatialHashGridComponent>(entity))
     {
       auto& shgc = registry.get<SpatialHashGridComponent>(entity);
+      shgc.isStale = false;
       int lastMinX = shgc.clientIndices.first.first;
       int lastMinY = shgc.clientIndices.first.second;
       int lastMaxX = shgc.clientIndices.second.first;
@@ -40,9 +41,28 @@ namespace flectron
   void SpatialHashGrid::clear()
   {
     cells.clear();
+    staleEntities.clear();
     queryIdentifier = 0;
   }
 
+  void SpatialHashGrid::markStale(entt::entity entity)
+  {
+    auto& shgc = registry.get<SpatialHashGridComponent>(entity);
+    if (shgc.isStale)
+      return;
+
+    shgc.isStale = true;
+    staleEntities.push_back(entity);
+  }
+
+  void SpatialHashGrid::update()
+  {
+    for (auto entity : staleEntities)
+      if (registry.valid(entity) && registry.all_of<SpatialHashGridComponent>(entity) && registry.get<SpatialHashGridComponent>(entity).isStale)
+        insert(entity);
+    staleEntities.clear();
+  }
+
   std::vector<entt::entity> SpatialHashGrid::getCells(const AABB& aabb)
   {
     int minX = (int)floor(aabb.min.x / cellSize);
@@ -57,7 +77,11 @@ namespace flectron
     {
       for (int y = minY; y <= maxY; y++)
       {
-        for (entt::entity entity : cells[getHash(x, y)])
+        auto cell = cells.find(getHash(x, y));
+        if (cell == cells.end())
+          continue;
+
+        for (entt::entity entity : cell->second)
         {
           auto& shgc = registry.get<SpatialHashGridComponent>(entity);
           if (shgc.clientQuery != id)
@@ -72,6 +96,34 @@ namespace flectron
     return result;
   }
 
+  std::vector<entt::entity> SpatialHashGrid::getEntitiesOutside(const AABB& aabb)
+  {
+    std::vector<entt::entity> result;
+    const int id = queryIdentifier++;
+
+    // Walks every occupied cell, so the cost grows with the populated part of the world,
+    // only the entities of cells lying completely within the bounds are left out
+    for (const auto& [hash, entities] : cells)
+    {
+      const float x = (float)getX(hash) * cellSize;
+      const float y = (float)getY(hash) * cellSize;
+      if (x >= aabb.min.x && x + cellSize <= aabb.max.x && y >= aabb.min.y && y + cellSize <= aabb.max.y)
+        continue;
+
+      for (entt::entity entity : entities)
+      {
+        auto& shgc = registry.get<SpatialHashGridComponent>(entity);
+        if (shgc.clientQuery != id)
+        {
+          shgc.clientQuery = id;
+          result.push_back(entity);
+        }
+      }
+    }
+
+    return result;
+  }
+
   void SpatialHashGrid::remove(entt::entity entity)
   {
     auto& shgc = registry.get<SpatialHashGridComponent>(entity);
@@ -84,7 +136,13 @@ namespace flectron
     {
       for (int y = minY; y <= maxY; y++)
       {
-        cells[getHash(x, y)].erase(entity);
+        auto cell = cells.find(getHash(x, y));
+        if (cell == cells.end())
+          continue;
+
+        cell->second.erase(entity);
+        if (cell->second.empty())
+          cells.erase(cell);
       }
     }
   }
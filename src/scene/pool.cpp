@@ -0,0 +1,88 @@
+#include <flectron/scene/pool.hpp>
+#include <flectron/scene/scene.hpp>
+#include <flectron/scene/components.hpp>
+#include <flectron/assert/assert.hpp>
+
+namespace flectron
+{
+
+  EntityPool::EntityPool(Scene& scene, const std::string& name, std::function<void(Entity)> prefab)
+    : scene(scene), name(name), prefab(prefab), inactive()
+  {}
+
+  Entity EntityPool::acquire(const Vector& position, float rotation)
+  {
+    auto& registry = scene.registry;
+
+    while (!inactive.empty())
+    {
+      entt::entity handle = inactive.back();
+      inactive.pop_back();
+
+      // The entity might have been destroyed directly while it was waiting in the pool
+      if (!registry.valid(handle))
+        continue;
+
+      Entity entity(handle, &registry);
+      auto& pc = entity.get<PositionComponent>();
+      pc.position = position;
+      pc.rotation = rotation;
+      entity.patch<PositionComponent>();
+
+      if (entity.has<PhysicsComponent>())
+      {
+        auto& phc = entity.get<PhysicsComponent>();
+        phc.linearVelocity = { 0.0f, 0.0f };
+        phc.rotationalVelocity = 0.0f;
+        phc.force = { 0.0f, 0.0f };
+        phc.torque = 0.0f;
+      }
+
+      entity.remove<InactiveComponent>();
+
+      if (entity.has<PhysicsComponent>())
+        scene.grid.insert(handle);
+
+      return entity;
+    }
+
+    Entity entity = scene.createEntity(name, position, rotation);
+    prefab(entity);
+    entity.add<PooledComponent>(this);
+    return entity;
+  }
+
+  void EntityPool::release(Entity entity)
+  {
+    FLECTRON_ASSERT(entity.has<PooledComponent>() && entity.get<PooledComponent>().pool == this, "Entity does not belong to this pool");
+    if (entity.has<InactiveComponent>())
+      return;
+
+    entity.add<InactiveComponent>();
+    if (entity.has<SpatialHashGridComponent>())
+      entity.remove<SpatialHashGridComponent>();
+
+    inactive.push_back(entity.getHandle());
+  }
+
+  void EntityPool::reserve(size_t count)
+  {
+    std::vector<Entity> entities;
+    while (available() + entities.size() < count)
+      entities.push_back(acquire({ 0.0f, 0.0f }));
+
+    for (auto& entity : entities)
+      release(entity);
+  }
+
+  void EntityPool::clear()
+  {
+    inactive.clear();
+  }
+
+  size_t EntityPool::available() const
+  {
+    return inactive.size();
+  }
+
+}
@@ -5,6 +5,9 @@
 #include <flectron/utils/profile.hpp>
 #include <flectron/application/application.hpp>
 
+#include <algorithm>
+#include <future>
+
 namespace flectron 
 {
 
@@ -24,16 +27,31 @@ namespace flectron
 
   int Scene::numCircleVerticies = 24; // TODO make this be appropriate for the body size
 
+  // Fewer entities than this per thread are not worth handing to a worker
+  static const size_t MinEntitiesPerRenderThread = 256;
+
   size_t Scene::minIterations = 1;
   size_t Scene::maxIterations = 128;
 
   Scene::Scene(size_t physicsIterations, size_t gridSize)
-    : registry(), grid(static_cast<int>(gridSize), registry), environment(), lightRenderer(nullptr), dateTime(nullptr), physicsIterations(physicsIterations)
+    : registry(), grid(static_cast<int>(gridSize), registry), environment(), lightRenderer(nullptr), dateTime(nullptr), physicsIterations(physicsIterations), isScriptSortRequired(false), isStaticBatchDirty(false), staticBatch(0), renderThreads(std::max<size_t>(1, FLECTRON_RENDER_THREADS)), renderWorkers(nullptr)
   {
     FLECTRON_LOG_TRACE("Creating scene");
     registry.on_construct<PhysicsComponent>().connect<&Scene::onPhysicsComponentCreate>(this);
     registry.on_destroy<SpatialHashGridComponent>().connect<&Scene::onSpatialHashGridComponentDestroy>(this);
-    registry.on_update<PositionComponent>().connect<&Scene::onPositionComponentUpdate>();
+    registry.on_update<PositionComponent>().connect<&Scene::onPositionComponentUpdate>(this);
+    registry.on_construct<ScriptComponent>().connect<&Scene::onScriptComponentChange>(this);
+    registry.on_update<ScriptComponent>().connect<&Scene::onScriptComponentChange>(this);
+    registry.on_destroy<ScriptComponent>().connect<&Scene::onScriptComponentChange>(this);
+    registry.on_construct<TagComponent>().connect<&Scene::onTagComponentCreate>(this);
+    registry.on_update<TagComponent>().connect<&Scene::onTagComponentUpdate>(this);
+    registry.on_destroy<TagComponent>().connect<&Scene::onTagComponentDestroy>(this);
+    registry.on_construct<InactiveComponent>().connect<&Scene::onInactiveComponentCreate>(this);
+    registry.on_destroy<InactiveComponent>().connect<&Scene::onInactiveComponentDestroy>(this);
+    registry.on_construct<StaticComponent>().connect<&Scene::onStaticComponentChange>(this);
+    registry.on_destroy<StaticComponent>().connect<&Scene::onStaticComponentChange>(this);
+    registry.on_construct<OccluderComponent>().connect<&Scene::onOccluderComponentCreate>(this);
+    registry.on_destroy<OccluderComponent>().connect<&Scene::onOccluderComponentDestroy>(this);
     registry.on_construct<PolygonComponent>().connect<&Scene::onBodyDefiningComponentCreate>();
     registry.on_construct<BoxComponent>().connect<&Scene::onBodyDefiningComponentCreate>();
     registry.on_construct<CircleComponent>().connect<&Scene::onBodyDefiningComponentCreate>();
@@ -42,6 +60,8 @@ namespace flectron
   Scene::~Scene()
   {
     FLECTRON_LOG_TRACE("Destroying scene");
+    if (staticBatch != 0)
+      Renderer::destroyStaticBatch(staticBatch);
   }
 
   void Scene::update(Application& application)
@@ -55,7 +75,7 @@ namespace flectron
     if (dateTime)
       dateTime->update(application.elapsedTime, environment);
 
-    for (auto& entity : registry.view<AnimationComponent>())
+    for (auto& entity : registry.view<AnimationComponent>(entt::exclude<InactiveComponent>))
       registry.get<AnimationComponent>(entity).update(application.elapsedTime);
 
     updatePhysics(application.elapsedTime, physicsIterations);
@@ -72,15 +92,22 @@ namespace flectron
     iterations = std::clamp(iterations, minIterations, maxIterations);
     float timeStep = elapsedTime / (float)iterations;
 
-    auto view = registry.view<PhysicsComponent>();
-    if (view.size() == 0)
+    auto view = registry.view<PhysicsComponent>(entt::exclude<InactiveComponent>);
+    if (view.begin() == view.end())
       return;
 
+    grid.update();
+
     for (size_t i = 0; i < iterations; ++i)
     {
       // movement
       for (auto entity : view)
-        view.get<PhysicsComponent>(entity).update(registry.get<PositionComponent>(entity), timeStep, environment.gravity);
+      {
+        auto& phc = view.get<PhysicsComponent>(entity);
+        phc.update(registry.get<PositionComponent>(entity), timeStep, environment.gravity);
+        if (!phc.isStatic)
+          grid.insert(entity);
+      }
 
       // collisions
       Collision collision;
@@ -136,18 +163,28 @@ namespace flectron
       Renderer::offscreen();
     window.clear();
 
-    auto renderables = registry.view<VertexComponent>();
-    for (auto entity : renderables)
-      if (registry.any_of<StrokeComponent, FillComponent, AnimationComponent, TextureComponent>(entity))
-        Entity(entity, &registry).render();
+    const Constraints bounds = window.camera.getBounds();
+    renderEntities(bounds);
 
-    auto lights = registry.view<LightComponent>();
-    if (!lights.empty())
+    auto lights = registry.view<LightComponent>(entt::exclude<InactiveComponent>);
+    if (lights.begin() != lights.end())
     {
       FLECTRON_ASSERT(lightRenderer != nullptr, "LightRenderer not initialized");
-      
+      updateOccluders();
+
+      // Lights that cannot reach the view are left out, the others keep their order between frames
       for (auto entity : lights)
+      {
+        const auto& pc = registry.get<PositionComponent>(entity);
+        const float radius = lights.get<LightComponent>(entity).lightRadius;
+        if (pc.position.x + radius < bounds.left || pc.position.x - radius > bounds.right || pc.position.y + radius < bounds.top || pc.position.y - radius > bounds.bottom)
+          continue;
+
+        if (registry.all_of<ShadowComponent>(entity))
+          updateShadow(entity, registry.get<ShadowComponent>(entity));
+
         lightRenderer->addLight({ entity, &registry });
+      }
     }
 
     if (lightRenderer != nullptr)
@@ -162,6 +199,160 @@ namespace flectron
     }
   }
 
+  void Scene::renderEntities()
+  {
+    for (auto entity : registry.view<TilemapComponent>(entt::exclude<InactiveComponent>))
+      registry.get<TilemapComponent>(entity).tilemap->render();
+
+    updateStaticBatch();
+    if (staticBatch != 0)
+      Renderer::drawStaticBatch(staticBatch);
+
+    auto renderables = registry.view<VertexComponent>(entt::exclude<InactiveComponent, StaticComponent>);
+    for (auto entity : renderables)
+      if (isRenderable(entity))
+        Entity(entity, &registry).render();
+  }
+
+  void Scene::renderEntities(const Constraints& constraints)
+  {
+    FLECTRON_PROFILE_EVENT("Scene::renderEntities");
+    grid.update();
+
+    for (auto entity : registry.view<TilemapComponent>(entt::exclude<InactiveComponent>))
+      registry.get<TilemapComponent>(entity).tilemap->render(constraints);
+
+    // Static entities are drawn as a whole, the batch is a single draw call anyway
+    updateStaticBatch();
+    if (staticBatch != 0)
+      Renderer::drawStaticBatch(staticBatch);
+
+    // Entities in the grid come only from the cells in view, the rest are tested one by one
+    std::vector<entt::entity> visible = grid.getCells({ constraints.left, constraints.top, constraints.right, constraints.bottom });
+    visible.erase(std::remove_if(visible.begin(), visible.end(), [&](entt::entity entity) {
+      return !registry.all_of<VertexComponent>(entity) || !isRenderable(entity) || registry.all_of<StaticComponent>(entity) || isOutside(entity, constraints);
+    }), visible.end());
+
+    for (auto entity : registry.view<VertexComponent>(entt::exclude<SpatialHashGridComponent, InactiveComponent, StaticComponent>))
+      if (isRenderable(entity) && !isOutside(entity, constraints))
+        visible.push_back(entity);
+
+    // Cells are unordered, so entities are drawn in the order a view over the vertex pool visits them,
+    // which walks the pool from its back, and overlapping entities keep their order between frames
+    const auto& vertices = registry.storage<VertexComponent>();
+    std::sort(visible.begin(), visible.end(), [&](entt::entity a, entt::entity b) {
+      return vertices.index(a) > vertices.index(b);
+    });
+    renderVisible(visible);
+  }
+
+  // The first chunk is drawn right away while workers record the others, submitting the
+  // buffers in order draws the entities in the same order as a single thread would
+  void Scene::renderVisible(const std::vector<entt::entity>& visible)
+  {
+    const size_t threads = std::min(renderThreads, visible.size() / MinEntitiesPerRenderThread);
+    if (threads <= 1)
+    {
+      for (auto entity : visible)
+        Entity(entity, &registry).render();
+      return;
+    }
+
+    FLECTRON_PROFILE_EVENT("Scene::renderVisible");
+    const size_t chunkSize = (visible.size() + threads - 1) / threads;
+    renderBuffers.resize(threads - 1);
+    if (renderWorkers == nullptr)
+      renderWorkers = createScope<WorkerPool>(renderThreads - 1);
+
+    std::vector<std::future<void>> workers;
+    workers.reserve(threads - 1);
+    for (size_t i = 1; i < threads; i++)
+    {
+      const size_t first = std::min(i * chunkSize, visible.size());
+      const size_t last = std::min(first + chunkSize, visible.size());
+      Renderer::CommandBuffer& buffer = renderBuffers[i - 1];
+      workers.push_back(renderWorkers->submit([this, &visible, &buffer, first, last]() {
+        Renderer::beginRecording(buffer);
+        try
+        {
+          for (size_t j = first; j < last; j++)
+            Entity(visible[j], &registry).render();
+        }
+        catch (...)
+        {
+          Renderer::endRecording();
+          throw;
+        }
+        Renderer::endRecording();
+      }));
+    }
+
+    // Buffers are only submitted once their job finished without throwing
+    size_t submitted = 0;
+    try
+    {
+      for (size_t j = 0; j < std::min(chunkSize, visible.size()); j++)
+        Entity(visible[j], &registry).render();
+
+      for (; submitted < workers.size(); submitted++)
+      {
+        workers[submitted].get();
+        Renderer::submit(renderBuffers[submitted]);
+      }
+    }
+    catch (...)
+    {
+      // The jobs still read visible and write their buffers, they have to finish before unwinding
+      for (size_t i = submitted; i < workers.size(); i++)
+        if (workers[i].valid())
+          workers[i].wait();
+      for (size_t i = submitted; i < renderBuffers.size(); i++)
+        renderBuffers[i].clear();
+      throw;
+    }
+  }
+
+  void Scene::setRenderThreads(size_t threads)
+  {
+    const size_t previous = renderThreads;
+    renderThreads = std::max<size_t>(1, threads);
+    if (renderThreads != previous)
+      renderWorkers.reset();
+  }
+
+  size_t Scene::getRenderThreads() const
+  {
+    return renderThreads;
+  }
+
+  void Scene::invalidateStaticBatch()
+  {
+    isStaticBatchDirty = true;
+  }
+
+  void Scene::updateStaticBatch()
+  {
+    if (!isStaticBatchDirty)
+      return;
+    isStaticBatchDirty = false;
+
+    if (staticBatch != 0)
+    {
+      Renderer::destroyStaticBatch(staticBatch);
+      staticBatch = 0;
+    }
+
+    auto statics = registry.view<StaticComponent, VertexComponent>(entt::exclude<InactiveComponent>);
+    if (statics.begin() == statics.end())
+      return;
+
+    Renderer::beginStaticBatch();
+    for (auto entity : statics)
+      if (isRenderable(entity))
+        Entity(entity, &registry).render();
+    staticBatch = Renderer::endStaticBatch();
+  }
+
   Entity Scene::createEntity(const std::string& name, const Vector& position, float rotation)
   {
     Entity entity(registry.create(), &registry);
@@ -183,12 +374,18 @@ namespace flectron
     return entity;
   }
 
+  EntityPool& Scene::createPool(const std::string& name, std::function<void(Entity)> prefab)
+  {
+    pools.push_back(createScope<EntityPool>(*this, name, prefab));
+    return *pools.back();
+  }
+
   ScriptComponentIterator Scene::updateScriptComponents(int max, ScriptComponentIterator iterator, ScriptComponentIterator end)
   {
     for (; iterator != end; ++iterator)
     {
       auto& script = registry.get<ScriptComponent>(*iterator);
-      if (script.order >= max)
+      if (script.getOrder() >= max)
         break;
       script.callback();
     }
@@ -205,8 +402,68 @@ namespace flectron
     grid.remove(entity);
   }
 
+  void Scene::onScriptComponentChange(entt::registry&, entt::entity)
+  {
+    // Removing a script swaps the last one into its slot, so it breaks the order just like adding does
+    isScriptSortRequired = true;
+  }
+
+  void Scene::onTagComponentCreate(entt::registry& registry, entt::entity entity)
+  {
+    auto& tc = registry.get<TagComponent>(entity);
+    if (tc.id >= tagIndex.size())
+      tagIndex.resize(tc.id + 1);
+    if (!registry.all_of<InactiveComponent>(entity))
+      tagIndex[tc.id].insert(entity);
+    tc.indexedID = tc.id;
+  }
+
+  void Scene::onTagComponentUpdate(entt::registry& registry, entt::entity entity)
+  {
+    auto& tc = registry.get<TagComponent>(entity);
+    if (tc.id == tc.indexedID)
+      return;
+    tagIndex[tc.indexedID].erase(entity);
+    onTagComponentCreate(registry, entity);
+  }
+
+  void Scene::onTagComponentDestroy(entt::registry& registry, entt::entity entity)
+  {
+    tagIndex[registry.get<TagComponent>(entity).indexedID].erase(entity);
+  }
+
+  // Inactive entities are taken out of the tag index so that tag counts only include live entities
+  void Scene::onInactiveComponentCreate(entt::registry& registry, entt::entity entity)
+  {
+    if (registry.all_of<TagComponent>(entity))
+      tagIndex[registry.get<TagComponent>(entity).indexedID].erase(entity);
+    if (registry.all_of<StaticComponent>(entity))
+      isStaticBatchDirty = true;
+    if (registry.all_of<OccluderComponent>(entity))
+      invalidateShadows();
+  }
+
+  void Scene::onInactiveComponentDestroy(entt::registry& registry, entt::entity entity)
+  {
+    if (registry.all_of<TagComponent>(entity))
+      tagIndex[registry.get<TagComponent>(entity).indexedID].insert(entity);
+    if (registry.all_of<StaticComponent>(entity))
+      isStaticBatchDirty = true;
+    if (registry.all_of<OccluderComponent>(entity))
+      invalidateShadows();
+  }
+
+  void Scene::onStaticComponentChange(entt::registry&, entt::entity)
+  {
+    isStaticBatchDirty = true;
+  }
+
   void Scene::onPositionComponentUpdate(entt::registry& registry, entt::entity entity)
   {
+    if (registry.all_of<StaticComponent>(entity))
+      isStaticBatchDirty = true;
+    if (registry.all_of<SpatialHashGridComponent>(entity))
+      grid.markStale(entity);
     if (registry.all_of<VertexComponent>(entity))
     {
       auto& vc = registry.get<VertexComponent>(entity);
@@ -216,6 +473,88 @@ namespace flectron
     }
     if (registry.all_of<TextureVertexComponent>(entity))
       registry.get<TextureVertexComponent>(entity).isTextureUpdateRequired = true;
+    if (registry.all_of<OccluderComponent>(entity))
+    {
+      auto& oc = registry.get<OccluderComponent>(entity);
+      if (!oc.isDirty)
+        movedOccluders.push_back(entity);
+      oc.isDirty = true;
+    }
+  }
+
+  void Scene::onOccluderComponentCreate(entt::registry&, entt::entity entity)
+  {
+    movedOccluders.push_back(entity);
+  }
+
+  void Scene::onOccluderComponentDestroy(entt::registry&, entt::entity)
+  {
+    invalidateShadows();
+  }
+
+  void Scene::invalidateShadows()
+  {
+    for (auto entity : registry.view<ShadowComponent>())
+      registry.get<ShadowComponent>(entity).isDirty = true;
+  }
+
+  static bool isInRadius(const Vector& position, float radius, const AABB& bounds)
+  {
+    return bounds.max.x > position.x - radius && bounds.min.x < position.x + radius && bounds.max.y > position.y - radius && bounds.min.y < position.y + radius;
+  }
+
+  // Lights whose radius reached a moved occluder before or after the move have to rebuild their shadows
+  void Scene::updateOccluders()
+  {
+    auto shadows = registry.view<ShadowComponent>();
+    for (auto entity : movedOccluders)
+    {
+      if (!registry.valid(entity) || !registry.all_of<OccluderComponent, VertexComponent>(entity))
+        continue;
+
+      auto& oc = registry.get<OccluderComponent>(entity);
+      const AABB previous = oc.bounds;
+      oc.bounds = registry.get<VertexComponent>(entity).getAABB(registry.get<PositionComponent>(entity));
+      oc.isDirty = false;
+
+      for (auto light : shadows)
+      {
+        auto& sc = shadows.get<ShadowComponent>(light);
+        if (!sc.isDirty && (isInRadius(sc.position, sc.radius, previous) || isInRadius(sc.position, sc.radius, oc.bounds)))
+          sc.isDirty = true;
+      }
+    }
+    movedOccluders.clear();
+  }
+
+  void Scene::updateShadow(entt::entity entity, ShadowComponent& sc)
+  {
+    const Vector& position = registry.get<PositionComponent>(entity).position;
+    const float radius = registry.get<LightComponent>(entity).lightRadius;
+    if (!sc.isDirty && sc.position == position && sc.radius == radius)
+      return;
+
+    FLECTRON_PROFILE_EVENT("Scene::updateShadow");
+    sc.position = position;
+    sc.radius = radius;
+    sc.isDirty = false;
+    ShadowMap::clear(sc.shadowMap);
+
+    auto cast = [&](entt::entity occluder) {
+      if (occluder == entity || !registry.all_of<OccluderComponent, VertexComponent>(occluder) || registry.all_of<InactiveComponent>(occluder))
+        return;
+
+      const auto& vertices = registry.get<VertexComponent>(occluder).getTransformedVertices(registry.get<PositionComponent>(occluder));
+      ShadowMap::cast(sc.shadowMap, position, radius, vertices.data(), vertices.size());
+    };
+
+    // Occluders in the grid are only taken from the cells the light reaches
+    grid.update();
+    for (auto occluder : grid.getCells({ position.x - radius, position.y - radius, position.x + radius, position.y + radius }))
+      cast(occluder);
+    for (auto occluder : registry.view<OccluderComponent>(entt::exclude<SpatialHashGridComponent, InactiveComponent>))
+      if (isInRadius(position, radius, registry.get<OccluderComponent>(occluder).bounds))
+        cast(occluder);
   }
 
   void Scene::onBodyDefiningComponentCreate(entt::registry& registry, entt::entity entity)
@@ -227,6 +566,10 @@ namespace flectron
   {
     registry.clear();
     grid.clear();
+    tagIndex.clear();
+    movedOccluders.clear();
+    for (auto& pool : pools)
+      pool->clear();
 
     if (lightRenderer != nullptr)
       lightRenderer->reset();
@@ -237,7 +580,62 @@ namespace flectron
 
   void Scene::removeEntity(entt::entity entity)
   {
-    registry.destroy(entity);
+    if (registry.all_of<PooledComponent>(entity))
+      registry.get<PooledComponent>(entity).pool->release({ entity, &registry });
+    else
+      registry.destroy(entity);
+  }
+
+  void Scene::removeEntities(std::vector<entt::entity>& entities)
+  {
+    auto pooled = std::partition(entities.begin(), entities.end(), [this](entt::entity entity) {
+      return !registry.all_of<PooledComponent>(entity);
+    });
+
+    for (auto it = pooled; it != entities.end(); ++it)
+      registry.get<PooledComponent>(*it).pool->release({ *it, &registry });
+
+    registry.destroy(entities.begin(), pooled);
+  }
+
+  bool Scene::isRenderable(entt::entity entity) const
+  {
+    return registry.any_of<StrokeComponent, FillComponent, AnimationComponent, TextureComponent>(entity);
+  }
+
+  bool Scene::isOutside(entt::entity entity, const Constraints& constraints)
+  {
+    auto& pc = registry.get<PositionComponent>(entity);
+    if (registry.all_of<VertexComponent>(entity))
+    {
+      const AABB& box = registry.get<VertexComponent>(entity).getAABB(pc);
+      return box.max.x < constraints.left || box.min.x > constraints.right ||
+             box.max.y < constraints.top  || box.min.y > constraints.bottom;
+    }
+
+    return pc.position.x < constraints.left || pc.position.x > constraints.right ||
+           pc.position.y < constraints.top  || pc.position.y > constraints.bottom;
+  }
+
+  size_t Scene::getEntityCount(const std::string& tag) const
+  {
+    return getEntitiesWithTag(tag).size();
+  }
+
+  const std::unordered_set<entt::entity>& Scene::getEntitiesWithTag(const std::string& tag) const
+  {
+    static const std::unordered_set<entt::entity> empty;
+    TagID id = Tags::find(tag);
+    if (id == Tags::Invalid || id >= tagIndex.size())
+      return empty;
+    return tagIndex[id];
+  }
+
+  void Scene::removeEntitiesWithTag(const std::string& tag)
+  {
+    const auto& tagged = getEntitiesWithTag(tag);
+    std::vector<entt::entity> entities(tagged.begin(), tagged.end());
+    removeEntities(entities);
   }
 
 }
\ No newline at end of file
@@ -92,16 +92,16 @@ namespace flectron
     if (targets & sts::Entities)
     {
       insert(buffer, ENTITIES_START);
-      auto serializable = registry.view<UUIDComponent>();
-      insert(buffer, serializable.size());
+      auto serializable = registry.view<UUIDComponent>(entt::exclude<InactiveComponent>);
+      insert(buffer, static_cast<size_t>(std::distance(serializable.begin(), serializable.end())));
       for (auto entityID : serializable)
       {
         Entity entity(entityID, &registry);
 
-        // FLECTRON_LOG_DEBUG("\tSerializing entity {}", entity.get<TagComponent>().tag);
+        // FLECTRON_LOG_DEBUG("\tSerializing entity {}", entity.get<TagComponent>().tag());
 
         insert(buffer, ENTITY_START);
-        insert(buffer, entity.get<TagComponent>().tag);
+        insert(buffer, entity.get<TagComponent>().tag());
         insert(buffer, serializable.get<UUIDComponent>(entityID).uuid);
 
         // serialize components
@@ -204,7 +204,7 @@ namespace flectron
         if (validate<ScriptComponent>(buffer, entity))
         {
           const auto& sc = entity.get<ScriptComponent>();
-          insert(buffer, sc.order);
+          insert(buffer, sc.getOrder());
         }
 
         if (entity.has<SerializationComponent>())
@@ -309,10 +309,10 @@ namespace flectron
         FLECTRON_ASSERT(stage == ENTITY_START, "Invalid scene data (ENTITY_START)");
         auto entity = createEntity();
 
-        entity.get<TagComponent>().tag = get<std::string>(from.data, offset);
+        entity.get<TagComponent>().setTag(get<std::string>(from.data, offset));
         entity.add<UUIDComponent>().uuid = get<uint64_t>(from.data, offset);
 
-        // FLECTRON_LOG_DEBUG("\tDeserializing entity: {}", entity.get<TagComponent>().tag);
+        // FLECTRON_LOG_DEBUG("\tDeserializing entity: {}", entity.get<TagComponent>().tag());
         onEntityCreation(entity);
 
         if (isValid(from.data, offset))
@@ -396,7 +396,7 @@ namespace flectron
         if (isValid(from.data, offset))
         {
           FLECTRON_ASSERT(entity.has<ScriptComponent>(), "Script component must be defined before deserializing script data");
-          entity.get<ScriptComponent>().order = get<int>(from.data, offset);
+          entity.get<ScriptComponent>().setOrder(get<int>(from.data, offset));
         }
 
         if (entity.has<DeserializationComponent>())
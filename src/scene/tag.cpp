@@ -0,0 +1,39 @@
+#include <flectron/scene/tag.hpp>
+#include <flectron/assert/assert.hpp>
+
+namespace flectron
+{
+
+  std::unordered_map<std::string, TagID> Tags::ids;
+  std::vector<std::string> Tags::names;
+
+  TagID Tags::intern(const std::string& tag)
+  {
+    auto it = ids.find(tag);
+    if (it != ids.end())
+      return it->second;
+
+    TagID id = static_cast<TagID>(names.size());
+    ids.emplace(tag, id);
+    names.push_back(tag);
+    return id;
+  }
+
+  TagID Tags::find(const std::string& tag)
+  {
+    auto it = ids.find(tag);
+    return it != ids.end() ? it->second : Invalid;
+  }
+
+  const std::string& Tags::name(TagID id)
+  {
+    FLECTRON_ASSERT(id < names.size(), "Unknown tag");
+    return names[id];
+  }
+
+  size_t Tags::count()
+  {
+    return names.size();
+  }
+
+}
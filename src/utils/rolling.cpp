@@ -0,0 +1,78 @@
+#include <flectron/utils/rolling.hpp>
+#include <flectron/assert/assert.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace flectron
+{
+
+  RollingStatistic::RollingStatistic(size_t capacity)
+    : samples(capacity, 0.0f), next(0u), count(0u)
+  {
+    FLECTRON_ASSERT(capacity > 0, "Rolling statistic needs room for at least one sample");
+  }
+
+  void RollingStatistic::add(float sample)
+  {
+    samples[next] = sample;
+    next = (next + 1) % samples.size();
+    count = std::min(count + 1, samples.size());
+  }
+
+  void RollingStatistic::clear()
+  {
+    next = 0u;
+    count = 0u;
+  }
+
+  size_t RollingStatistic::size() const
+  {
+    return count;
+  }
+
+  size_t RollingStatistic::capacity() const
+  {
+    return samples.size();
+  }
+
+  float RollingStatistic::latest() const
+  {
+    return count == 0 ? 0.0f : samples[(next + samples.size() - 1) % samples.size()];
+  }
+
+  float RollingStatistic::minimum() const
+  {
+    return count == 0 ? 0.0f : *std::min_element(samples.begin(), samples.begin() + count);
+  }
+
+  float RollingStatistic::maximum() const
+  {
+    return count == 0 ? 0.0f : *std::max_element(samples.begin(), samples.begin() + count);
+  }
+
+  float RollingStatistic::average() const
+  {
+    if (count == 0)
+      return 0.0f;
+
+    float sum = 0.0f;
+    for (size_t i = 0; i < count; i++)
+      sum += samples[i];
+    return sum / (float)count;
+  }
+
+  float RollingStatistic::percentile(float fraction) const
+  {
+    if (count == 0)
+      return 0.0f;
+
+    // Until the window fills up the samples are stored from the start
+    std::vector<float> sorted(samples.begin(), samples.begin() + count);
+    const size_t rank = (size_t)std::ceil(std::clamp(fraction, 0.0f, 1.0f) * (float)count);
+    const size_t index = rank == 0 ? 0 : rank - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+  }
+
+}
@@ -4,83 +4,184 @@
 #include <flectron/physics/math.hpp>
 #include <flectron/assert/assert.hpp>
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace flectron
 {
 
-  std::vector<size_t> trianglesFromVertices(std::vector<Vector>& vertices)
+  float polygonCross(const std::vector<Vector>& vertices)
   {
-    FLECTRON_ASSERT(vertices.size() >= 3, "Too few vertices");
-    FLECTRON_ASSERT(isSimplePolygon(vertices), "Not a simple polygon");
-    FLECTRON_ASSERT(!containsColinearEdges(vertices), "Polygon contains colinear edges");
-
-    WindingOrder order = getWindingOrder(vertices);
-    FLECTRON_ASSERT(order != WindingOrder::Invalid, "Invalid winding order");
+    float sum = 0.0f;
 
-    if (order == WindingOrder::CounterClockwise)
-      for (size_t i = 0; i < vertices.size(); i++)
-        std::swap(vertices[i], vertices[vertices.size() - 1 - i]);
+    for (int i = 0; i < vertices.size(); i++)
+      sum += cross(vertices[i], vertices[getIndex(i + 1, (int)vertices.size())]);
+    
+    return sum;
+  }
 
-    std::vector<size_t> indexList;
-    for (size_t i = 0; i < vertices.size(); i++)
-      indexList.push_back(i);
+  // Triangulations of recently seen outlines, keyed by the hash of their vertices
+  static const std::size_t MaxCachedTriangulations = 256;
 
+  struct CachedTriangulation
+  {
+    std::vector<Vector> vertices;
     std::vector<size_t> triangles;
-    triangles.resize((vertices.size() - 2) * 3);
-    int index = 0;
+    bool isReversed;
+  };
 
-    while (indexList.size() > 3)
+  static std::unordered_map<size_t, CachedTriangulation> triangulations;
+
+  static size_t hashVertices(const std::vector<Vector>& vertices)
+  {
+    size_t hash = std::hash<size_t>()(vertices.size());
+    for (const auto& vertex : vertices)
     {
-      for (size_t i = 0; i < indexList.size(); i++)
-      {
-        size_t a = indexList[i];
-        size_t b = indexList[getIndex((int)i - 1, (int)indexList.size())];
-        size_t c = indexList[getIndex((int)i + 1, (int)indexList.size())];
+      hash ^= std::hash<float>()(vertex.x) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      hash ^= std::hash<float>()(vertex.y) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+  }
 
-        Vector va = vertices[a];
-        Vector vb = vertices[b];
-        Vector vc = vertices[c];
+  static bool isConvexCorner(const Vector& previous, const Vector& current, const Vector& next)
+  {
+    return cross(previous - current, next - current) >= 0.0f;
+  }
+
+  // Ear clipping over a linked list of the remaining vertices, only reflex vertices can lie
+  // inside an ear, and clipping an ear only changes its two neighbours, so each vertex is
+  // tested a bounded number of times against the reflex ones
+  static std::vector<size_t> clipEars(const std::vector<Vector>& vertices)
+  {
+    const size_t count = vertices.size();
+    std::vector<size_t> previous(count);
+    std::vector<size_t> next(count);
+    std::vector<char> isReflex(count);
+    std::vector<char> isEar(count);
+    std::vector<size_t> reflexVertices;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      previous[i] = (i + count - 1) % count;
+      next[i] = (i + 1) % count;
+      isReflex[i] = !isConvexCorner(vertices[previous[i]], vertices[i], vertices[next[i]]);
+      if (isReflex[i])
+        reflexVertices.push_back(i);
+    }
 
-        Vector va2vb = vb - va;
-        Vector va2vc = vc - va;
+    auto testEar = [&](size_t i) {
+      if (isReflex[i])
+        return false;
 
-        if (cross(va2vb, va2vc) < 0.0f)
+      const size_t b = previous[i];
+      const size_t c = next[i];
+      for (size_t r : reflexVertices)
+      {
+        if (r == b || r == c || !isReflex[r])
           continue;
 
-        bool isEar = true;
+        if (isPointInTriangle(vertices[r], vertices[b], vertices[i], vertices[c]))
+          return false;
+      }
+      return true;
+    };
 
-        for (size_t j = 0; j < vertices.size(); j++)
-        {
-          if (j == a || j == b || j == c)
-            continue;
-          
-          Vector p = vertices[j];
+    for (size_t i = 0; i < count; i++)
+      isEar[i] = testEar(i);
 
-          if (isPointInTriangle(p, vb, va, vc))
-          {
-            isEar = false;
-            break;
-          }
+    std::vector<size_t> triangles;
+    triangles.reserve((count - 2) * 3);
 
-        }
-        
-        if (isEar)
+    size_t remaining = count;
+    size_t current = 0;
+    while (remaining > 3)
+    {
+      size_t steps = 0;
+      while (!isEar[current])
+      {
+        current = next[current];
+        FLECTRON_ASSERT(++steps <= remaining, "Polygon has no ear left to clip");
+      }
+
+      const size_t b = previous[current];
+      const size_t c = next[current];
+      triangles.push_back(b);
+      triangles.push_back(current);
+      triangles.push_back(c);
+
+      next[b] = c;
+      previous[c] = b;
+      remaining--;
+
+      // Neighbours can only turn from reflex to convex, so the reflex list only shrinks
+      bool isReflexChanged = false;
+      for (size_t neighbour : { b, c })
+      {
+        if (isReflex[neighbour] && isConvexCorner(vertices[previous[neighbour]], vertices[neighbour], vertices[next[neighbour]]))
         {
-          triangles[index++] = b;
-          triangles[index++] = a;
-          triangles[index++] = c;
-          indexList.erase(std::next(indexList.begin(), i));
-          break;
+          isReflex[neighbour] = false;
+          isReflexChanged = true;
         }
       }
+
+      if (isReflexChanged)
+        reflexVertices.erase(std::remove_if(reflexVertices.begin(), reflexVertices.end(), [&](size_t r) { return !isReflex[r]; }), reflexVertices.end());
+
+      isEar[b] = testEar(b);
+      isEar[c] = testEar(c);
+      current = c;
     }
 
-    triangles[index++] = indexList[0];
-    triangles[index++] = indexList[1];
-    triangles[index++] = indexList[2];
+    triangles.push_back(previous[current]);
+    triangles.push_back(current);
+    triangles.push_back(next[current]);
 
     return triangles;
   }
 
+  std::vector<size_t> trianglesFromVertices(std::vector<Vector>& vertices)
+  {
+    FLECTRON_ASSERT(vertices.size() >= 3, "Too few vertices");
+
+    // A hit skips the validation too, the same outline already passed it
+    const size_t hash = hashVertices(vertices);
+    auto it = triangulations.find(hash);
+    if (it != triangulations.end() && it->second.vertices == vertices)
+    {
+      if (it->second.isReversed)
+        std::reverse(vertices.begin(), vertices.end());
+      return it->second.triangles;
+    }
+
+    FLECTRON_ASSERT(isSimplePolygon(vertices), "Not a simple polygon");
+    FLECTRON_ASSERT(!containsColinearEdges(vertices), "Polygon contains colinear edges");
+
+    WindingOrder order = getWindingOrder(vertices);
+    FLECTRON_ASSERT(order != WindingOrder::Invalid, "Invalid winding order");
+
+    CachedTriangulation triangulation;
+    triangulation.vertices = vertices;
+    triangulation.isReversed = order == WindingOrder::CounterClockwise;
+
+    if (triangulation.isReversed)
+      std::reverse(vertices.begin(), vertices.end());
+
+    triangulation.triangles = clipEars(vertices);
+
+    if (it == triangulations.end() && triangulations.size() >= MaxCachedTriangulations)
+      triangulations.clear();
+
+    // New or colliding key, the entry is replaced
+    CachedTriangulation& cached = triangulations[hash];
+    cached = std::move(triangulation);
+    return cached.triangles;
+  }
+
+  void clearTriangulationCache()
+  {
+    triangulations.clear();
+  }
+
   int getIndex(int index, int length)
   {
     if (index >= length)
@@ -110,23 +211,15 @@ namespace flectron
     return true;
   }
 
+  // The sign of the area, counting turns fails on outlines with as many reflex corners as convex ones
   WindingOrder getWindingOrder(const std::vector<Vector>& vertices)
   {
-    int sum{ 0 };
-
-    for (int i = 0; i < vertices.size(); i++)
-    {
-      Vector a = vertices[i];
-      Vector b = vertices[getIndex(i - 1, (int)vertices.size())];
-      Vector c = vertices[getIndex(i + 1, (int)vertices.size())];
-
-      sum += orientation(b, a, c);
-    }
+    const float sum = polygonCross(vertices);
 
-    if (sum > 0)
+    if (sum < 0.0f)
       return WindingOrder::Clockwise;
 
-    if (sum < 0)
+    if (sum > 0.0f)
       return WindingOrder::CounterClockwise;
 
     return WindingOrder::Invalid;
@@ -206,16 +299,6 @@ namespace flectron
     return false;
   }
 
-  float polygonCross(const std::vector<Vector>& vertices)
-  {
-    float sum = 0.0f;
-
-    for (int i = 0; i < vertices.size(); i++)
-      sum += cross(vertices[i], vertices[getIndex(i + 1, (int)vertices.size())]);
-    
-    return sum;
-  }
-
   float polygonArea(const std::vector<Vector>& vertices)
   {
     return std::abs(polygonCross(vertices)) * 0.5f;
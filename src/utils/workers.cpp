@@ -0,0 +1,64 @@
+#include <flectron/utils/workers.hpp>
+#include <flectron/assert/assert.hpp>
+
+namespace flectron
+{
+
+  WorkerPool::WorkerPool(size_t threadCount)
+    : threads(), jobs(), mutex(), condition(), isStopping(false)
+  {
+    FLECTRON_ASSERT(threadCount > 0, "Worker pool needs at least one thread");
+    threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++)
+      threads.emplace_back(&WorkerPool::work, this);
+  }
+
+  // Jobs that were already submitted are finished before the threads stop
+  WorkerPool::~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      isStopping = true;
+    }
+    condition.notify_all();
+
+    for (auto& thread : threads)
+      thread.join();
+  }
+
+  size_t WorkerPool::size() const
+  {
+    return threads.size();
+  }
+
+  std::future<void> WorkerPool::submit(std::function<void()> job)
+  {
+    std::packaged_task<void()> task(std::move(job));
+    std::future<void> result = task.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push_back(std::move(task));
+    }
+    condition.notify_one();
+    return result;
+  }
+
+  void WorkerPool::work()
+  {
+    while (true)
+    {
+      std::packaged_task<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return isStopping || !jobs.empty(); });
+        if (jobs.empty())
+          return;
+
+        task = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      task();
+    }
+  }
+
+}
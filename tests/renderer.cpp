@@ -0,0 +1,778 @@
+#include "tests.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <future>
+#include <thread>
+
+using namespace flectron;
+
+class MappedRecordingBackend : public RecordingRendererBackend
+{
+public:
+  std::vector<LineVertex> mapped = std::vector<LineVertex>(RendererBackend::MaxVertexCount);
+  const LineVertex* submitted = nullptr;
+
+  LineVertex* mapLineVertices() override { return mapped.data(); }
+
+  void drawLines(const LineVertex* vertices, size_t vertexCount) override
+  {
+    submitted = vertices;
+    RecordingRendererBackend::drawLines(vertices, vertexCount);
+  }
+};
+
+class TimedRecordingBackend : public RecordingRendererBackend
+{
+public:
+  size_t frames = 0;
+
+  using RecordingRendererBackend::RecordingRendererBackend;
+
+  void endFrameTimer() override { frames++; }
+
+  bool getFrameTime(float& milliseconds) override
+  {
+    milliseconds = (float)frames;
+    return frames > 0;
+  }
+};
+
+// Single white pixel, enough to give an image a texture and a layer
+struct PixelLoader : Image::Loader
+{
+  void operator()(Image::DataPointer& destination, Image::DataSize& size, Image::Dim& width, Image::Dim& height, Image::Dim& channels) const override
+  {
+    width = height = 1;
+    channels = 4;
+    size = 4;
+    destination = new unsigned char[4]{ 255, 255, 255, 255 };
+  }
+};
+
+// Swaps a backend in for one test and puts the previous one back when it goes out of scope
+template<typename Backend = RecordingRendererBackend>
+class ScopedBackend
+{
+private:
+  Scope<RendererBackend> previous;
+
+public:
+  Backend& recording;
+
+  template<typename ...Args>
+  ScopedBackend(Args&&... args)
+    : previous(Renderer::setBackend(createScope<Backend>(std::forward<Args>(args)...))),
+      recording(static_cast<Backend&>(Renderer::backend()))
+  {}
+
+  ~ScopedBackend()
+  {
+    Renderer::setBackend(std::move(previous));
+  }
+};
+
+TEST_SUITE("Renderer tests")
+{
+
+  TEST("Quads should be batched until texture slots run out")
+  {
+    ScopedBackend<> backend(4);
+    auto& recording = backend.recording;
+
+    Renderer::quad({ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f }, Colors::red());
+    Renderer::quad({ 1.0f, 0.0f }, { 2.0f, 0.0f }, { 2.0f, 1.0f }, { 1.0f, 1.0f }, 10u, 1.0f);
+    Renderer::quad({ 2.0f, 0.0f }, { 3.0f, 0.0f }, { 3.0f, 1.0f }, { 2.0f, 1.0f }, 11u, 1.0f);
+    Renderer::quad({ 3.0f, 0.0f }, { 4.0f, 0.0f }, { 4.0f, 1.0f }, { 3.0f, 1.0f }, 12u, 1.0f);
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 2u);
+    ASSERT_EQUAL(recording.drawCalls[0].indexCount, 18u);
+    ASSERT_EQUAL(recording.drawCalls[0].textureSlots.size(), 4u);
+    ASSERT_EQUAL(recording.drawCalls[0].textureSlots[2], 10u);
+    ASSERT_EQUAL(recording.drawCalls[1].vertexCount, 4u);
+    ASSERT_EQUAL(recording.textureVertices.size(), 16u);
+    ASSERT_EQUAL(recording.textureVertices[4].textureIndex, 2.0f);
+  }
+
+  TEST("Circles and lines should be recorded in their own batches")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    Renderer::circle({ 0.0f, 0.0f }, 2.0f, Colors::white());
+    Renderer::line({ 0.0f, 0.0f }, { 1.0f, 1.0f }, Colors::white());
+    Renderer::triangle({ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, Colors::white());
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 3u);
+    ASSERT_EQUAL(recording.circleVertices.size(), 4u);
+    ASSERT_EQUAL(recording.circleVertices[2].worldPosition.x, 2.0f);
+    ASSERT_EQUAL(recording.lineVertices.size(), 4u);
+    ASSERT_EQUAL(recording.textureIndices.size(), 3u);
+  }
+
+  TEST("Swapping backends should draw what was batched for the previous one")
+  {
+    auto previous = Renderer::setBackend(createScope<RecordingRendererBackend>());
+    Renderer::circle({ 0.0f, 0.0f }, 1.0f, Colors::white());
+
+    auto swapped = Renderer::setBackend(std::move(previous));
+    auto& recording = static_cast<RecordingRendererBackend&>(*swapped);
+    ASSERT_EQUAL(recording.drawCalls.size(), 1u);
+    ASSERT_EQUAL(recording.circleVertices.size(), 4u);
+  }
+
+  TEST("Scenes should render without a window")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    Scene scene(1u, 4u);
+    auto box = scene.createEntity("Box", { 0.0f, 0.0f }, 0.0f);
+    box.add<BoxComponent>(1.0f, 1.0f);
+    box.add<FillComponent>(Colors::white());
+    scene.createEntity("Circle", { 3.0f, 0.0f }, 0.0f).add<CircleComponent>(1.0f);
+
+    scene.renderEntities();
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 1u);
+    ASSERT_GT(recording.textureVertices.size(), 0u);
+  }
+
+  TEST("Batches should be written into mapped backend memory")
+  {
+    ScopedBackend<MappedRecordingBackend> backend;
+    auto& mapped = backend.recording;
+
+    Renderer::line({ 0.0f, 0.0f }, { 5.0f, 0.0f }, Colors::white());
+    Renderer::endBatch();
+
+    ASSERT(mapped.submitted == mapped.mapped.data(), "Lines should be submitted from the mapped memory");
+    ASSERT_EQUAL(mapped.mapped[3].position.x, 6.0f);
+  }
+
+  TEST("Quads and ellipses should be instanced when enabled")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+    Renderer::setInstancing(true);
+
+    Renderer::rect({ 0.0f, 0.0f }, { 2.0f, 1.0f }, Colors::white());
+    Renderer::quad({ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f }, 7u, { 0.5f, 0.0f, 0.5f, 1.0f });
+    Renderer::circle({ 1.0f, 1.0f }, 1.0f, Colors::white());
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 2u);
+    ASSERT_EQUAL(recording.textureVertices.size(), 0u);
+    ASSERT_EQUAL(recording.quadInstances.size(), 2u);
+    ASSERT_EQUAL(recording.quadInstances[0].corners[2].x, 2.0f);
+    ASSERT_EQUAL(recording.quadInstances[1].texturePosition.x, 0.5f);
+    ASSERT_EQUAL(recording.quadInstances[1].textureIndex, 2.0f);
+    ASSERT_EQUAL(recording.circleInstances.size(), 1u);
+    ASSERT_EQUAL(recording.circleInstances[0].corners[0].x, 0.0f);
+
+    Renderer::setInstancing(false);
+  }
+
+  TEST("Instanced quads should keep their order with polygons")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+    Renderer::setInstancing(true);
+
+    Renderer::rect({ 0.0f, 0.0f }, { 2.0f, 2.0f }, Colors::red());
+    Renderer::triangle({ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, Colors::green());
+    Renderer::rect({ 0.0f, 0.0f }, { 1.0f, 1.0f }, Colors::blue());
+    Renderer::rect({ 1.0f, 0.0f }, { 1.0f, 1.0f }, Colors::blue());
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 3u);
+    ASSERT(recording.drawCalls[0].type == RecordedBatches::BatchType::QuadInstances, "The first quad should be drawn first");
+    ASSERT_EQUAL(recording.drawCalls[0].vertexCount, 1u);
+    ASSERT(recording.drawCalls[1].type == RecordedBatches::BatchType::Texture, "The triangle should be drawn between the quads");
+    ASSERT(recording.drawCalls[2].type == RecordedBatches::BatchType::QuadInstances, "The last quads should be drawn last");
+    ASSERT_EQUAL(recording.drawCalls[2].vertexCount, 2u);
+    ASSERT_EQUAL(recording.drawCalls[2].vertexOffset, 1u);
+
+    // Runs that keep switching are still drawn from a single flush
+    recording.reset();
+    Renderer::beginFrame();
+    Renderer::beginBatch();
+    for (int i = 0; i < 50; i++)
+    {
+      Renderer::rect({ (float)i, 0.0f }, { 1.0f, 1.0f }, Colors::blue());
+      Renderer::rect({ (float)i, 1.0f }, { 1.0f, 1.0f }, Colors::blue());
+      Renderer::triangle({ (float)i, 0.0f }, { i + 1.0f, 0.0f }, { (float)i, 1.0f }, Colors::green());
+    }
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(Renderer::statistics().totalFlushes(), 1u);
+    ASSERT_EQUAL(recording.drawCalls.size(), 100u);
+    ASSERT_EQUAL(recording.quadInstances.size(), 100u);
+    ASSERT_EQUAL(recording.textureIndices.size(), 150u);
+    ASSERT(recording.drawCalls[99].type == RecordedBatches::BatchType::Texture, "The last triangle should be drawn last");
+    ASSERT_EQUAL(recording.drawCalls[99].indexOffset, 147u);
+    Renderer::endFrame();
+
+    Renderer::setInstancing(false);
+  }
+
+  TEST("Sorted submissions should be grouped by layer and texture")
+  {
+    ScopedBackend<> backend(3);
+    auto& recording = backend.recording;
+    Renderer::setSorting(true);
+
+    Renderer::setLayer(1);
+    Renderer::circle({ 0.0f, 0.0f }, 1.0f, Colors::white());
+
+    Renderer::setLayer(0);
+    for (uint32_t texture : { 10u, 11u, 12u, 10u, 11u, 12u })
+      Renderer::square({ 0.0f, 0.0f }, 1.0f, texture, 1.0f);
+    Renderer::line({ 0.0f, 0.0f }, { 1.0f, 1.0f }, Colors::white());
+    ASSERT_EQUAL(recording.drawCalls.size(), 0u);
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 4u);
+    ASSERT(recording.drawCalls[0].type == RecordingRendererBackend::BatchType::Texture, "Lower layer quads should be drawn first");
+    ASSERT_EQUAL(recording.drawCalls[0].indexCount, 24u);
+    ASSERT_EQUAL(recording.drawCalls[1].indexCount, 12u);
+    ASSERT(recording.drawCalls[2].type == RecordingRendererBackend::BatchType::Line, "Lines should be flushed before the next layer");
+    ASSERT(recording.drawCalls[3].type == RecordingRendererBackend::BatchType::Circle, "Higher layer circles should be drawn last");
+    ASSERT_EQUAL(recording.textureVertices[4].textureIndex, 1.0f);
+
+    Renderer::setSorting(false);
+    Renderer::setLayer(0);
+  }
+
+  TEST("Textures in the texture array should not take slots")
+  {
+    ScopedBackend<> backend(2);
+    auto& recording = backend.recording;
+
+    Image images[3] = { Image(createRef<PixelLoader>()), Image(createRef<PixelLoader>()), Image(createRef<PixelLoader>()) };
+    for (auto& image : images)
+    {
+      image.load();
+      image.loadGPU();
+    }
+
+    auto array = createRef<TextureArray>(1, 1, 2);
+    const int layers[3] = { array->add(images[0]), array->add(images[1]), array->add(images[2]) };
+    ASSERT_EQUAL(layers[0], 0);
+    ASSERT_EQUAL(layers[1], 1);
+    ASSERT_EQUAL(layers[2], -1);
+    Renderer::setTextureArray(array);
+
+    Renderer::beginFrame();
+    Renderer::beginBatch();
+    Renderer::square({ 0.0f, 0.0f }, 1.0f, images[0].getGPU(), 1.0f);
+    Renderer::square({ 1.0f, 0.0f }, 1.0f, images[1].getGPU(), 1.0f);
+    Renderer::square({ 2.0f, 0.0f }, 1.0f, images[2].getGPU(), 1.0f);
+    Renderer::square({ 3.0f, 0.0f }, 1.0f, images[0].getGPU(), 1.0f);
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 1u);
+    ASSERT_EQUAL(recording.drawCalls[0].textureSlots.size(), 2u);
+    ASSERT_EQUAL(recording.textureVertices[0].textureIndex, -1.0f);
+    ASSERT_EQUAL(recording.textureVertices[4].textureIndex, -2.0f);
+    ASSERT_EQUAL(recording.textureVertices[8].textureIndex, 1.0f);
+    ASSERT_EQUAL(recording.textureVertices[12].textureIndex, -1.0f);
+    ASSERT_EQUAL(Renderer::statistics().flushes(Renderer::FlushReason::TextureSlots), 0u);
+    Renderer::endFrame();
+
+    Renderer::setTextureArray(nullptr);
+  }
+
+  TEST("Texture slots should be found without scanning")
+  {
+    ScopedBackend<> backend(33);
+    auto& recording = backend.recording;
+
+    // 1024 and 2048 share an entry of the slot table with 0
+    const uint32_t colliding[] = { 2048u, 1024u, 2048u };
+    for (uint32_t texture : colliding)
+      Renderer::square({ 0.0f, 0.0f }, 1.0f, texture, 1.0f);
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 1u);
+    ASSERT_EQUAL(recording.textureVertices[8].textureIndex, 1.0f);
+    ASSERT_EQUAL(recording.textureVertices[4].textureIndex, 2.0f);
+
+    recording.reset();
+    Renderer::beginBatch();
+
+    // Textures that are already bound keep their slot for the rest of the batch
+    const size_t quadCount = 64;
+    for (size_t i = 0; i < quadCount; i++)
+      Renderer::square({ 0.0f, 0.0f }, 1.0f, 100u + (uint32_t)(i % 32), 1.0f);
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 1u);
+    ASSERT_EQUAL(recording.textureVertices.size(), quadCount * 4);
+    ASSERT_EQUAL(recording.textureVertices[4 * 33].textureIndex, 2.0f);
+    ASSERT_EQUAL(recording.drawCalls[0].textureSlots.size(), 33u);
+  }
+
+  TEST("Scenes should only render entities in view")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    Scene scene(1u, 4u);
+    auto spawn = [&](const Vector& position, bool physics) {
+      auto entity = scene.createEntity("Box", position, 0.0f);
+      entity.add<BoxComponent>(1.0f, 1.0f);
+      entity.add<FillComponent>(Colors::white());
+      if (physics)
+        entity.add<PhysicsComponent>(1.0f, 0.5f, true);
+      return entity;
+    };
+
+    spawn({ 0.0f, 0.0f }, false);
+    spawn({ 50.0f, 0.0f }, false);
+    spawn({ 2.0f, 2.0f }, true);
+    spawn({ -40.0f, 0.0f }, true);
+    auto moved = spawn({ 0.0f, 60.0f }, true);
+
+    scene.renderEntities();
+    Renderer::endBatch();
+    const size_t boxVertices = recording.textureVertices.size() / 5;
+    ASSERT_GT(boxVertices, 0u);
+
+    // The grid has to notice the move even though physics never ran
+    moved.get<PositionComponent>().moveTo({ -3.0f, 1.0f });
+    recording.reset();
+    Renderer::beginBatch();
+    scene.renderEntities(Constraints(-10.0f, 10.0f, -10.0f, 10.0f));
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.textureVertices.size(), boxVertices * 3);
+  }
+
+  TEST("Static entities should be drawn from a retained batch")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    Scene scene(1u, 4u);
+    auto spawn = [&](const Vector& position, bool isStatic) {
+      auto entity = scene.createEntity("Box", position, 0.0f);
+      entity.add<BoxComponent>(1.0f, 1.0f);
+      entity.add<FillComponent>(Colors::white());
+      if (isStatic)
+        entity.add<StaticComponent>();
+      return entity;
+    };
+
+    auto wall = spawn({ 0.0f, 0.0f }, true);
+    spawn({ 2.0f, 0.0f }, true);
+    spawn({ 4.0f, 0.0f }, false);
+
+    scene.renderEntities();
+    Renderer::endBatch();
+    ASSERT_EQUAL(recording.staticBatches.size(), 1u);
+    ASSERT_EQUAL(recording.drawCalls.size(), 2u);
+    ASSERT(recording.drawCalls[0].type == RecordingRendererBackend::BatchType::Static, "Static batch should be drawn first");
+    const size_t batch = recording.drawCalls[0].vertexOffset;
+    ASSERT_EQUAL(recording.staticBatches[batch].textureVertices.size(), recording.textureVertices.size() * 2);
+
+    recording.reset();
+    Renderer::beginBatch();
+    scene.renderEntities();
+    Renderer::endBatch();
+    ASSERT_EQUAL(recording.drawCalls[0].vertexOffset, batch);
+
+    wall.get<PositionComponent>().move({ 0.0f, 1.0f });
+    recording.reset();
+    Renderer::beginBatch();
+    scene.renderEntities();
+    Renderer::endBatch();
+    ASSERT_EQUAL(recording.staticBatches.size(), 1u);
+    ASSERT_NOT_EQUAL(recording.drawCalls[0].vertexOffset, batch);
+  }
+
+  TEST("Tilemaps should only rebuild changed chunks in view")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    Tile grass(5u, { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 1.0f });
+    Tile water(6u, { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f, 1.0f });
+    Tilemap tilemap(40u, 40u, 1.0f, { 0.0f, 0.0f });
+    for (size_t y = 0; y < 40u; y++)
+      for (size_t x = 0; x < 40u; x++)
+        tilemap.set(x, y, &grass);
+
+    // Only the first chunk is in view
+    Renderer::beginBatch();
+    tilemap.render(Constraints(1.0f, 5.0f, 1.0f, 5.0f));
+    Renderer::endBatch();
+    ASSERT_EQUAL(recording.staticBatches.size(), 1u);
+    ASSERT_EQUAL(recording.drawCalls.size(), 1u);
+    ASSERT(recording.drawCalls[0].type == RecordingRendererBackend::BatchType::Static, "Chunk should be drawn from a static batch");
+    const size_t batch = recording.drawCalls[0].vertexOffset;
+    ASSERT_EQUAL(recording.staticBatches[batch].textureVertices.size(), Tilemap::ChunkSize * Tilemap::ChunkSize * 4);
+
+    recording.reset();
+    Renderer::beginBatch();
+    tilemap.render(Constraints(1.0f, 5.0f, 1.0f, 5.0f));
+    Renderer::endBatch();
+    ASSERT_EQUAL(recording.drawCalls[0].vertexOffset, batch);
+    ASSERT_EQUAL(recording.textureVertices.size(), 0u);
+
+    tilemap.set(3u, 3u, &water);
+    recording.reset();
+    Renderer::beginBatch();
+    tilemap.render(Constraints(1.0f, 5.0f, 1.0f, 5.0f));
+    Renderer::endBatch();
+    ASSERT_EQUAL(recording.staticBatches.size(), 1u);
+    ASSERT_NOT_EQUAL(recording.drawCalls[0].vertexOffset, batch);
+
+    // The remaining chunks are baked once they come into view
+    recording.reset();
+    Renderer::beginBatch();
+    tilemap.render();
+    Renderer::endBatch();
+    ASSERT_EQUAL(recording.staticBatches.size(), 9u);
+    ASSERT_EQUAL(recording.drawCalls.size(), 9u);
+  }
+
+  TEST("Text should be laid out from the glyph table")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    Image image;
+    image.textureID = 7u;
+    auto atlas = createRef<FontAtlas>(image, 4, 2, "abcdefgh");
+    ASSERT_EQUAL(atlas->getGlyph('f').x, 0.25f);
+    ASSERT_EQUAL(atlas->getGlyph('f').y, 0.5f);
+    ASSERT_EQUAL(atlas->getGlyph('?').x, atlas->getGlyph('a').x);
+
+    Renderer::text(atlas, { 1.0f, 2.0f }, "ab\nc", 4.0f);
+    Renderer::endBatch();
+    ASSERT_EQUAL(recording.textureVertices.size(), 12u);
+    ASSERT_EQUAL(recording.textureVertices[0].position.x, 1.0f);
+    ASSERT_EQUAL(recording.textureVertices[4].position.x, 2.0f);
+    ASSERT_EQUAL(recording.textureVertices[8].position.y, 0.0f);
+    ASSERT_EQUAL(recording.drawCalls[0].textureSlots[1], 7u);
+
+    // Long strings are drawn from the cached run
+    const std::string text = "abcdefgh\nhgfedcba\nabcd";
+    std::vector<TextureVertex> vertices[2];
+    for (auto& drawn : vertices)
+    {
+      recording.reset();
+      Renderer::beginBatch();
+      Renderer::text(atlas, { 3.0f, 0.0f }, text, 2.0f);
+      Renderer::endBatch();
+      drawn = recording.textureVertices;
+    }
+    ASSERT_EQUAL(vertices[0].size(), 20u * 4u);
+    ASSERT_EQUAL(vertices[1].size(), vertices[0].size());
+    for (size_t i = 0; i < vertices[0].size(); i++)
+    {
+      ASSERT_EQUAL(vertices[0][i].position.x, vertices[1][i].position.x);
+      ASSERT_EQUAL(vertices[0][i].textureCoord.y, vertices[1][i].textureCoord.y);
+    }
+
+    image.textureID = 0u;
+  }
+
+  TEST("Outlines should be drawn as one joined strip")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    const std::vector<Vector> square = { { 0.0f, 0.0f }, { 2.0f, 0.0f }, { 2.0f, 2.0f }, { 0.0f, 2.0f } };
+    Renderer::outline(square, 0.5f);
+    Renderer::endBatch();
+
+    // Every corner is shared by both of its edges and the strip returns to the first one
+    ASSERT_EQUAL(recording.lineVertices.size(), 10u);
+    auto isNear = [](const glm::vec2& a, const glm::vec2& b) { return glm::length(a - b) < 1e-5f; };
+    ASSERT(isNear(recording.lineVertices[0].position, { -0.5f, -0.5f }), "Outer corner should be mitered");
+    ASSERT(isNear(recording.lineVertices[1].position, { 0.5f, 0.5f }), "Inner corner should be mitered");
+    ASSERT_EQUAL(recording.lineVertices[8].position.x, recording.lineVertices[0].position.x);
+
+    // Stroked entities are joined to the previous strip by degenerate triangles
+    recording.reset();
+    Renderer::beginBatch();
+    Scene scene(1u, 4u);
+    for (float x = 0.0f; x < 2.0f; x++)
+    {
+      auto box = scene.createEntity("Box", { x * 3.0f, 0.0f }, 0.0f);
+      box.add<BoxComponent>(1.0f, 1.0f);
+      box.add<StrokeComponent>(Colors::white(), 0.1f);
+    }
+    scene.renderEntities();
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 1u);
+    ASSERT_EQUAL(recording.lineVertices.size(), 22u);
+    ASSERT_EQUAL(recording.lineVertices[10].position.x, recording.lineVertices[9].position.x);
+    ASSERT_EQUAL(recording.lineVertices[11].position.x, recording.lineVertices[12].position.x);
+  }
+
+  TEST("Lights should only be listed in the tiles they reach")
+  {
+    const Light lights[] = {
+      { { 0.5f, 0.5f }, 0.4f, 0.0f, { 1.0f, 1.0f, 1.0f, 1.0f } },
+      { { 8.0f, 8.0f }, 1.2f, 0.0f, { 1.0f, 0.5f, 0.0f, 1.0f } },
+      { { 100.0f, 100.0f }, 5.0f, 0.0f, { 1.0f, 1.0f, 1.0f, 1.0f } }
+    };
+
+    LightTiles tiles;
+    tiles.build(lights, 3, { 0.0f, 0.0f }, { 16.0f, 16.0f });
+
+    ASSERT_EQUAL(tiles.getCount(0, 0), 1);
+    ASSERT_EQUAL(tiles.getLights(0, 0)[0], 0);
+    ASSERT_EQUAL(tiles.getCount(7, 7), 1);
+    ASSERT_EQUAL(tiles.getLights(7, 7)[0], 1);
+    ASSERT_EQUAL(tiles.getCount(6, 7), 1);
+    ASSERT_EQUAL(tiles.getCount(6, 6), 0);
+    ASSERT_EQUAL(tiles.getCount(15, 15), 0);
+
+    // The corner tiles of the second light are outside of its radius, the third light is out of view
+    const size_t headerSize = LightTiles::Columns * LightTiles::Rows * 2;
+    ASSERT_EQUAL(tiles.getData().size(), headerSize + 1 + 12);
+  }
+
+  TEST("Occluders should shorten the shadow map behind them")
+  {
+    std::vector<float> shadowMap;
+    ShadowMap::clear(shadowMap);
+
+    // A box to the right of the light covers the directions around +x
+    const Vector box[] = { { 5.0f, -1.0f }, { 7.0f, -1.0f }, { 7.0f, 1.0f }, { 5.0f, 1.0f } };
+    ShadowMap::cast(shadowMap, { 0.0f, 0.0f }, 10.0f, box, 4);
+
+    const int right = ShadowMap::Resolution / 2;
+    const int up = ShadowMap::Resolution * 3 / 4;
+    auto isNear = [](float a, float b) { return std::abs(a - b) < 1e-3f; };
+    ASSERT(isNear(shadowMap[right], 0.5f), "Light should stop at the near side of the box");
+    ASSERT(isNear(shadowMap[right - 1], 0.5f), "Light should stop at the near side of the box");
+    ASSERT_EQUAL(shadowMap[up], 1.0f);
+    ASSERT_EQUAL(shadowMap[0], 1.0f);
+
+    // Occluders beyond the radius do not change anything
+    const Vector far[] = { { -20.0f, -1.0f }, { -19.0f, -1.0f }, { -19.0f, 1.0f } };
+    ShadowMap::cast(shadowMap, { 0.0f, 0.0f }, 10.0f, far, 3);
+    ASSERT_EQUAL(shadowMap[0], 1.0f);
+    ASSERT_EQUAL(shadowMap[ShadowMap::Resolution - 1], 1.0f);
+  }
+
+  TEST("Uniform names should hash the same at compile time and at runtime")
+  {
+    constexpr UniformName hashed("uCameraPosition");
+    static_assert(hashed.hash == hashUniformName("uCameraPosition", 15), "Uniform names should be hashed at compile time");
+
+    const std::string name = "uCameraPosition";
+    ASSERT_EQUAL(UniformName(name).hash, hashed.hash);
+    ASSERT(UniformName(std::string("uWindowSize")).hash != hashed.hash, "Different names should have different hashes");
+  }
+
+  TEST("Program binaries should only be loaded for matching sources and drivers")
+  {
+    const auto directory = std::filesystem::temp_directory_path() / "flectron-program-cache-test";
+    std::filesystem::remove_all(directory);
+    FileProgramCache cache(directory.string());
+
+    const uint64_t key = ProgramCache::key("Vendor|Renderer|4.6", { "vertex", "", "fragment", "" });
+    ASSERT(key != ProgramCache::key("Vendor|Renderer|4.5", { "vertex", "", "fragment", "" }), "Driver should be part of the key");
+    ASSERT(key != ProgramCache::key("Vendor|Renderer|4.6", { "vertexf", "", "ragment", "" }), "Stage boundaries should be part of the key");
+
+    ProgramCache::Binary binary;
+    ASSERT(!cache.load(key, binary), "Empty cache should miss");
+
+    ProgramCache::Binary stored;
+    stored.format = 42;
+    stored.data = { 'b', 'i', 'n' };
+    cache.store(key, stored);
+
+    ASSERT(cache.load(key, binary), "Stored program should hit");
+    ASSERT_EQUAL(binary.format, (GLenum)42);
+    ASSERT_EQUAL(binary.data.size(), (size_t)3);
+    ASSERT_EQUAL(binary.data[2], 'n');
+
+    const uint64_t otherDriver = ProgramCache::key("Vendor|Renderer|4.5", { "vertex", "", "fragment", "" });
+    ASSERT(!cache.load(otherDriver, binary), "Other driver should miss");
+
+    // A truncated file falls back to compiling
+    const auto path = directory / std::filesystem::directory_iterator(directory)->path().filename();
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    ASSERT(!cache.load(key, binary), "Truncated program should miss");
+
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST("Statistics should count flushes by batch type and reason")
+  {
+    ScopedBackend<TimedRecordingBackend> backend(4);
+    const bool wasGpuTiming = Renderer::isGpuTiming();
+    Renderer::setGpuTiming(true);
+    auto& statistics = Renderer::statistics();
+    statistics.clearHistory();
+
+    Renderer::beginFrame();
+    Renderer::beginBatch();
+    Renderer::quad({ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f }, 10u, 1.0f);
+    Renderer::quad({ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f }, 11u, 1.0f);
+    Renderer::quad({ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f }, 12u, 1.0f);
+    Renderer::quad({ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f }, 13u, 1.0f);
+    Renderer::line({ 0.0f, 0.0f }, { 1.0f, 1.0f }, Colors::white());
+    Renderer::endBatch();
+    Renderer::endFrame();
+
+    ASSERT_EQUAL(statistics.textureDrawCalls(), 4u);
+    ASSERT_EQUAL(statistics.flushes(Renderer::Statistics::BatchType::Texture), 2u);
+    ASSERT_EQUAL(statistics.flushes(Renderer::Statistics::BatchType::Line), 1u);
+    ASSERT_EQUAL(statistics.totalFlushes(), 3u);
+    ASSERT_EQUAL(statistics.flushes(Renderer::FlushReason::TextureSlots), 1u);
+    ASSERT_EQUAL(statistics.flushes(Renderer::FlushReason::EndBatch), 2u);
+    ASSERT_EQUAL(statistics.vertices(), 20u);
+    ASSERT_EQUAL(statistics.indices(), 24u);
+    ASSERT_EQUAL(statistics.uploadedBytes(), 16 * sizeof(TextureVertex) + 24 * sizeof(uint32_t) + 4 * sizeof(LineVertex));
+    ASSERT_EQUAL(statistics.gpuTime(), 1.0f);
+    ASSERT(statistics.cpuTime() >= statistics.submitTime(), "Submitting should be part of the frame");
+
+    Renderer::beginFrame();
+    Renderer::beginBatch();
+    Renderer::endBatch();
+    Renderer::endFrame();
+
+    ASSERT_EQUAL(statistics.totalFlushes(), 0u);
+    ASSERT_EQUAL(statistics.flushesPerFrame().size(), 2u);
+    ASSERT_EQUAL(statistics.flushesPerFrame().maximum(), 3.0f);
+    ASSERT_EQUAL(statistics.flushesPerFrame().minimum(), 0.0f);
+    ASSERT_EQUAL(statistics.flushesPerFrame().average(), 1.5f);
+    ASSERT_EQUAL(statistics.gpuTimes().latest(), 2.0f);
+
+    Renderer::setGpuTiming(wasGpuTiming);
+  }
+
+  TEST("Rolling statistics should only keep the last samples")
+  {
+    RollingStatistic statistic(4);
+    ASSERT_EQUAL(statistic.percentile(0.5f), 0.0f);
+
+    for (int i = 1; i <= 6; i++)
+      statistic.add((float)i);
+
+    ASSERT_EQUAL(statistic.size(), 4u);
+    ASSERT_EQUAL(statistic.latest(), 6.0f);
+    ASSERT_EQUAL(statistic.minimum(), 3.0f);
+    ASSERT_EQUAL(statistic.maximum(), 6.0f);
+    ASSERT_EQUAL(statistic.average(), 4.5f);
+    ASSERT_EQUAL(statistic.percentile(0.5f), 4.0f);
+    ASSERT_EQUAL(statistic.percentile(0.99f), 6.0f);
+    ASSERT_EQUAL(statistic.percentile(0.0f), 3.0f);
+  }
+
+  TEST("Worker pools should keep their threads between jobs")
+  {
+    WorkerPool workers(2);
+    std::vector<std::thread::id> ids(8);
+    std::vector<std::future<void>> jobs;
+    for (size_t i = 0; i < ids.size(); i++)
+      jobs.push_back(workers.submit([&ids, i]() { ids[i] = std::this_thread::get_id(); }));
+    for (auto& job : jobs)
+      job.get();
+
+    std::sort(ids.begin(), ids.end());
+    ASSERT_LTE(std::distance(ids.begin(), std::unique(ids.begin(), ids.end())), 2);
+    ASSERT(ids[0] != std::this_thread::get_id(), "Jobs should run on the workers");
+  }
+
+  TEST("Command buffers recorded on other threads should be drawn where they are submitted")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    Renderer::CommandBuffer buffer;
+    std::thread worker([&]() {
+      Renderer::beginRecording(buffer);
+      Renderer::square({ 10.0f, 0.0f }, 1.0f, Colors::white());
+      Renderer::circle({ 0.0f, 0.0f }, 1.0f, Colors::white());
+      Renderer::endRecording();
+    });
+    worker.join();
+
+    ASSERT(!Renderer::isRecording(), "Recording should only affect the worker thread");
+    ASSERT_EQUAL(buffer.size(), 2u);
+    ASSERT_EQUAL(recording.drawCalls.size(), 0u);
+
+    Renderer::square({ 0.0f, 0.0f }, 1.0f, Colors::white());
+    Renderer::submit(buffer);
+    Renderer::square({ 20.0f, 0.0f }, 1.0f, Colors::white());
+    Renderer::endBatch();
+
+    ASSERT(buffer.empty(), "Submitted buffers should be cleared");
+    ASSERT_EQUAL(recording.textureVertices.size(), 12u);
+    ASSERT_EQUAL(recording.textureVertices[0].position.x, 0.0f);
+    ASSERT_EQUAL(recording.textureVertices[4].position.x, 10.0f);
+    ASSERT_EQUAL(recording.textureVertices[8].position.x, 20.0f);
+    ASSERT_EQUAL(recording.circleVertices.size(), 4u);
+
+    // With sorting the recorded layers decide the order
+    Renderer::beginBatch();
+    recording.reset();
+    Renderer::setSorting(true);
+    std::thread sortedWorker([&]() {
+      Renderer::beginRecording(buffer);
+      Renderer::setLayer(1);
+      Renderer::square({ 10.0f, 0.0f }, 1.0f, Colors::white());
+      Renderer::endRecording();
+    });
+    sortedWorker.join();
+
+    Renderer::submit(buffer);
+    Renderer::square({ 0.0f, 0.0f }, 1.0f, Colors::white());
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.drawCalls.size(), 2u);
+    ASSERT_EQUAL(recording.textureVertices[0].position.x, 0.0f);
+    ASSERT_EQUAL(recording.textureVertices[4].position.x, 10.0f);
+
+    Renderer::setSorting(false);
+  }
+
+  TEST("Scenes should render the same on several threads")
+  {
+    ScopedBackend<> backend;
+    auto& recording = backend.recording;
+
+    Scene scene(1u, 4u);
+    for (int i = 0; i < 1000; i++)
+    {
+      auto entity = scene.createEntity("Box", { (float)(i % 40) * 2.0f - 40.0f, (float)(i / 40) * 2.0f - 25.0f }, 0.0f);
+      entity.add<BoxComponent>(1.0f, 1.0f);
+      entity.add<FillComponent>(Colors::white());
+      if (i % 3 == 0)
+        entity.add<StrokeComponent>(Colors::red(), 0.1f);
+    }
+
+    const Constraints bounds(-100.0f, 100.0f, -100.0f, 100.0f);
+    scene.renderEntities(bounds);
+    Renderer::endBatch();
+    const auto serialVertices = recording.textureVertices;
+    const size_t serialLineVertices = recording.lineVertices.size();
+
+    recording.reset();
+    Renderer::beginBatch();
+    scene.setRenderThreads(4);
+    scene.renderEntities(bounds);
+    Renderer::endBatch();
+
+    ASSERT_EQUAL(recording.textureVertices.size(), serialVertices.size());
+    ASSERT_EQUAL(recording.lineVertices.size(), serialLineVertices);
+    bool isSameOrder = true;
+    for (size_t i = 0; i < serialVertices.size(); i++)
+      isSameOrder = isSameOrder && recording.textureVertices[i].position.x == serialVertices[i].position.x && recording.textureVertices[i].position.y == serialVertices[i].position.y;
+    ASSERT(isSameOrder, "Entities should be drawn in the same order");
+  }
+
+}
@@ -0,0 +1,176 @@
+#include "tests.hpp"
+
+using namespace flectron;
+
+TEST_SUITE("Scene tests")
+{
+
+  TEST("Scripts should run in order")
+  {
+    Scene scene(1u, 4u);
+    std::vector<int> calls;
+
+    scene.createScript("Second", [&]() { calls.push_back(2); }, 2);
+    scene.createScript("First", [&]() { calls.push_back(1); }, 1);
+    auto third = scene.createScript("Third", [&]() { calls.push_back(3); }, 3);
+
+    auto scripts = scene.getScriptComponents();
+    scene.updateScriptComponents(std::numeric_limits<int>::max(), scripts.begin(), scripts.end());
+    ASSERT_EQUAL(calls.size(), 3u);
+    ASSERT(calls[0] == 1 && calls[1] == 2 && calls[2] == 3, "Scripts should be sorted by order");
+
+    calls.clear();
+    third.get<ScriptComponent>().setOrder(0);
+    scripts = scene.getScriptComponents();
+    scene.updateScriptComponents(std::numeric_limits<int>::max(), scripts.begin(), scripts.end());
+    ASSERT_EQUAL(calls.size(), 3u);
+    ASSERT(calls[0] == 3 && calls[1] == 1 && calls[2] == 2, "Changing the order should resort scripts");
+
+    calls.clear();
+    scripts = scene.getScriptComponents();
+    auto iterator = scene.updateScriptComponents(2, scripts.begin(), scripts.end());
+    ASSERT_EQUAL(calls.size(), 2u);
+    scene.updateScriptComponents(std::numeric_limits<int>::max(), iterator, scripts.end());
+    ASSERT_EQUAL(calls.size(), 3u);
+  }
+
+  TEST("Systems should visit entities with all components")
+  {
+    Scene scene(1u, 4u);
+
+    auto moving = scene.createEntity("Moving", { 0.0f, 0.0f }, 0.0f);
+    moving.add<BoxComponent>(1.0f, 1.0f);
+    moving.add<FillComponent>();
+    scene.createEntity("Static", { 5.0f, 0.0f }, 0.0f).add<BoxComponent>(1.0f, 1.0f);
+
+    int visited = 0;
+    scene.addSystem<PositionComponent, FillComponent>([&](PositionComponent& pc, FillComponent&) {
+      pc.move({ 1.0f, 0.0f });
+      ++visited;
+    }, 1);
+
+    auto scripts = scene.getScriptComponents();
+    scene.updateScriptComponents(std::numeric_limits<int>::max(), scripts.begin(), scripts.end());
+    ASSERT_EQUAL(visited, 1);
+    ASSERT_EQUAL(moving.get<PositionComponent>().position.x, 1.0f);
+  }
+
+  TEST("Tag index should follow tag changes")
+  {
+    Scene scene(1u, 4u);
+
+    auto a = scene.createEntity("Box", { 0.0f, 0.0f }, 0.0f);
+    auto b = scene.createEntity("Box", { 2.0f, 0.0f }, 0.0f);
+    scene.createEntity("Circle", { 4.0f, 0.0f }, 0.0f);
+    ASSERT_EQUAL(scene.getEntityCount("Box"), 2u);
+    const size_t tagCount = Tags::count();
+    ASSERT_EQUAL(scene.getEntityCount("Missing"), 0u);
+    ASSERT_EQUAL(Tags::count(), tagCount);
+
+    b.get<TagComponent>().setTag("Circle");
+    ASSERT_EQUAL(scene.getEntityCount("Box"), 1u);
+    ASSERT_EQUAL(scene.getEntityCount("Circle"), 2u);
+    for (auto entity : scene.getEntitiesWithTag("Box"))
+    {
+      ASSERT(a == entity, "Only the untouched box should stay indexed");
+    }
+
+    scene.removeEntitiesWithTag("Circle");
+    ASSERT_EQUAL(scene.getEntityCount("Circle"), 0u);
+    ASSERT_EQUAL(scene.getEntityCount("Box"), 1u);
+  }
+
+  TEST("Entities outside constraints should be removed")
+  {
+    Scene scene(1u, 4u);
+
+    auto spawn = [&](const Vector& position, bool physics) {
+      auto entity = scene.createEntity("Box", position, 0.0f);
+      entity.add<BoxComponent>(1.0f, 1.0f);
+      if (physics)
+        entity.add<PhysicsComponent>(1.0f, 0.5f, false);
+      entity.add<TemporaryComponent>();
+      return entity;
+    };
+
+    spawn({ 1.0f, 1.0f }, true);
+    spawn({ -2.0f, 3.0f }, false);
+    spawn({ -50.0f, -3.0f }, true);
+    spawn({ 60.0f, 0.0f }, false);
+    scene.createEntity("Kept", { 100.0f, 0.0f }, 0.0f).add<BoxComponent>(1.0f, 1.0f);
+
+    scene.removeEntitiesOutside<TemporaryComponent>(Constraints(-10.0f, 10.0f, -10.0f, 10.0f));
+    ASSERT_EQUAL(scene.getEntityCount<TemporaryComponent>(), 2u);
+    ASSERT_EQUAL(scene.getEntityCount("Kept"), 1u);
+  }
+
+  TEST("Pooled entities should be reused")
+  {
+    Scene scene(1u, 4u);
+    auto& pool = scene.createPool("Bullet", [](Entity entity) {
+      entity.add<CircleComponent>(0.5f);
+      entity.add<PhysicsComponent>(1.0f, 0.5f, false);
+      entity.add<TemporaryComponent>();
+    });
+
+    pool.reserve(2);
+    ASSERT_EQUAL(pool.available(), 2u);
+    ASSERT_EQUAL(scene.getEntityCount("Bullet"), 0u);
+    ASSERT_EQUAL(scene.getEntityCount<TemporaryComponent>(), 0u);
+
+    auto bullet = pool.acquire({ 3.0f, 4.0f });
+    ASSERT_EQUAL(pool.available(), 1u);
+    ASSERT_EQUAL(scene.getEntityCount("Bullet"), 1u);
+    ASSERT(bullet.has<SpatialHashGridComponent>(), "Acquired bullet should be in the grid");
+    ASSERT_EQUAL(bullet.get<PositionComponent>().position.x, 3.0f);
+
+    scene.removeEntity(bullet.getHandle());
+    ASSERT_EQUAL(pool.available(), 2u);
+    ASSERT(bullet.has<InactiveComponent>(), "Removed bullet should be kept inactive");
+    ASSERT(!bullet.has<SpatialHashGridComponent>(), "Inactive bullet should leave the grid");
+
+    auto again = pool.acquire({ -1.0f, 0.0f });
+    ASSERT(again == bullet, "Released bullet should be reused");
+    ASSERT_EQUAL(again.get<PositionComponent>().position.x, -1.0f);
+    ASSERT_EQUAL(scene.getEntityCount<CircleComponent>(), 1u);
+  }
+
+
+  TEST("Concave outlines should be triangulated once")
+  {
+    clearTriangulationCache();
+
+    // Counter-clockwise star with every other vertex pulled in
+    std::vector<Vector> outline;
+    const int points = 200;
+    for (int i = 0; i < points; i++)
+    {
+      const float angle = 2.0f * (float)M_PI * (float)i / (float)points;
+      const float radius = i % 2 == 0 ? 10.0f : 6.0f;
+      outline.push_back({ radius * std::cos(angle), radius * std::sin(angle) });
+    }
+
+    std::vector<Vector> vertices = outline;
+    const auto triangles = trianglesFromVertices(vertices);
+    ASSERT_EQUAL(triangles.size(), (size_t)(points - 2) * 3);
+    ASSERT(vertices[0] == outline[points - 1], "Counter-clockwise outlines should be reversed");
+
+    float area = 0.0f;
+    bool isClockwise = true;
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+      const Vector& a = vertices[triangles[i]];
+      const Vector& b = vertices[triangles[i + 1]];
+      const Vector& c = vertices[triangles[i + 2]];
+      const float doubleArea = cross(a - b, c - b);
+      isClockwise = isClockwise && doubleArea >= 0.0f;
+      area += doubleArea * 0.5f;
+    }
+    ASSERT(isClockwise, "Triangles should keep the winding of the outline");
+    ASSERT(std::abs(area - polygonArea(vertices)) < 1e-2f, "Triangles should cover the outline exactly");
+
+    std::vector<Vector> again = outline;
+    ASSERT(trianglesFromVertices(again) == triangles, "Same outline should reuse its triangles");
+    ASSERT(again == vertices, "Cached outlines should be reversed as well");
+  }
+}